@@ -1,14 +1,46 @@
+QT += concurrent
+
+#пути от каталога библиотеки - файл подключается и из проектов тестов
+INCLUDEPATH += $$PWD
+
 SOURCES += \
-    chart/plainchart.cpp \
-    chart/chartaxis.cpp \
-    chart/chartlayer.cpp \
-    chart/charttext.cpp \
-    chart/chartdata.cpp
+    $$PWD/plainchart.cpp \
+    $$PWD/chartaxis.cpp \
+    $$PWD/chartlayer.cpp \
+    $$PWD/charttext.cpp \
+    $$PWD/chartdata.cpp \
+    $$PWD/chartseries.cpp \
+    $$PWD/chartkernels.cpp \
+    $$PWD/chartindex.cpp \
+    $$PWD/chartrenderer.cpp \
+    $$PWD/chartmarker.cpp \
+    $$PWD/chartdensity.cpp \
+    $$PWD/chartgeometry.cpp \
+    $$PWD/charttextcache.cpp \
+    $$PWD/chartticks.cpp \
+    $$PWD/chartpyramid.cpp \
+    $$PWD/chartdatafile.cpp \
+    $$PWD/chartingest.cpp \
+    $$PWD/chartfeed.cpp
 
 HEADERS += \
-    chart/plainchart.h \
-    chart/chartaxis.h \
-    chart/chartlayer.h \
-    chart/chartlayeritem.h \
-    chart/charttext.h \
-    chart/chartdata.h
+    $$PWD/plainchart.h \
+    $$PWD/chartaxis.h \
+    $$PWD/chartbounds.h \
+    $$PWD/chartlayer.h \
+    $$PWD/chartlayeritem.h \
+    $$PWD/charttext.h \
+    $$PWD/chartdata.h \
+    $$PWD/chartseries.h \
+    $$PWD/chartkernels.h \
+    $$PWD/chartindex.h \
+    $$PWD/chartrenderer.h \
+    $$PWD/chartmarker.h \
+    $$PWD/chartdensity.h \
+    $$PWD/chartgeometry.h \
+    $$PWD/charttextcache.h \
+    $$PWD/chartticks.h \
+    $$PWD/chartpyramid.h \
+    $$PWD/chartdatafile.h \
+    $$PWD/chartingest.h \
+    $$PWD/chartfeed.h
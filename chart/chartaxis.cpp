@@ -8,17 +8,38 @@
 #include <QtMath>
 
 
-ChartGrid::ChartGrid()
-    : zeroLinePen(QPen(Qt::gray, 0.8, Qt::DashDotDotLine)),
+ChartGrid::ChartGrid(ChartAxis* owner)
+    : axis(owner),
+    zeroLinePen(QPen(Qt::gray, 0.8, Qt::DashDotDotLine)),
     gridPen(QPen(Qt::gray, 0.8, Qt::DashDotDotLine)),
     anglePen(QPen(Qt::darkGray, 0.8, Qt::DashDotDotLine)),
-    drawAngle(false)
+    drawAngle(false),
+    cacheHeight(0),
+    cached(true), valid(false)
 {
 }
 
-void ChartGrid::paint(QPainter* painter, const QVector<QPair<QPointF, QPointF> >& points)
+void ChartGrid::setCached(bool enabled)
 {
-    if (points.isEmpty())
+    cached = enabled;
+    valid = false;
+
+    if (!cached)
+        cache = QImage();
+}
+
+void ChartGrid::changed()
+{
+    valid = false;
+
+    //растр сетки входит в кэш слоя осей
+    if (axis != NULL)
+        axis->changed();
+}
+
+void ChartGrid::paint(QPainter* painter, const QVector<QLineF>& lines, int height)
+{
+    if (lines.isEmpty())
         return;
 
     const QTransform oldTr = painter->transform();
@@ -26,33 +47,72 @@ void ChartGrid::paint(QPainter* painter, const QVector<QPair<QPointF, QPointF> >
 
     initPainter(painter);
 
-    const QPair<QPointF, QPointF>& zeroLine = points.at(0);
+    if (!cached)
+    {
+        paintLines(painter, lines, height);
+
+        painter->setTransform(oldTr);
+        painter->setWindow(oldWindow);
+        return;
+    }
 
+    const qreal ratio = painter->device()->devicePixelRatioF();
+    const QSize size = painter->window().size() * ratio;
+
+    if (cache.size() != size || cache.devicePixelRatio() != ratio)
+    {
+        cache = QImage(size, QImage::Format_ARGB32_Premultiplied);
+        cache.setDevicePixelRatio(ratio);
+        valid = false;
+    }
+
+    if (!valid || height != cacheHeight || lines != cacheLines)
+    {
+        cache.fill(Qt::transparent);
+
+        QPainter cache_painter(&cache);
+        cache_painter.setRenderHints(painter->renderHints());
+
+        paintLines(&cache_painter, lines, height);
+
+        cacheLines = lines;
+        cacheHeight = height;
+        valid = true;
+    }
+
+    painter->drawImage(0, 0, cache);
+
+    painter->setTransform(oldTr);
+    painter->setWindow(oldWindow);
+}
+
+void ChartGrid::paintLines(QPainter* painter, const QVector<QLineF>& lines, int height)
+{
     painter->setPen(zeroLinePen);
-    painter->drawLine(zeroLine.first, zeroLine.second);
+    painter->drawLine(lines.at(0));
 
-    painter->setPen(gridPen);
-    for (int i = 1; i < points.size(); ++i)
+    //все линии сетки одним вызовом
+    if (lines.size() > 1)
     {
-        const QPair<QPointF, QPointF> pair = points.at(i);
-        painter->drawLine(pair.first, pair.second);
+        painter->setPen(gridPen);
+        painter->drawLines(lines.constData() + 1, lines.size() - 1);
     }
 
     if (drawAngle)
     {
-        painter->setPen(anglePen);
-        const int max_y = static_cast<QWidget*>(painter->device())->height();
+        const int max_y = height;
+        QLineF angle_lines[5];
 
-        for (int i = 15; i <= 75; i += 15)
+        for (int i = 15, j = 0; i <= 75; i += 15, ++j)
         {
             const double x = max_y / qTan(i);
 
-            painter->drawLine(0, max_y, x, 0);
+            angle_lines[j] = QLineF(0, max_y, x, 0);
         }
-    }
 
-    painter->setTransform(oldTr);
-    painter->setWindow(oldWindow);
+        painter->setPen(anglePen);
+        painter->drawLines(angle_lines, 5);
+    }
 }
 
 void ChartGrid::initPainter(QPainter* painter)
@@ -64,13 +124,14 @@ void ChartGrid::initPainter(QPainter* painter)
 ChartAxis::ChartAxis(PlainChart* parent, bool is_horiz, bool is_invert)
     : ChartLayerItem(),
     ChartRange(),
-    grd(new ChartGrid()),
+    grd(new ChartGrid(this)),
     chart(parent),
     labelPen(QPen(Qt::gray)),
     numOfTicks(5), numOfSubTicks(5),
     lbPos(0), prev(0),
     isHoriz(is_horiz), isInvert(is_invert), divide(false),
-    offst(0), shft(0), cellSize(0)
+    offst(0), shft(0), cellSize(0),
+    labelDivided(false)
 {
     if (is_horiz)
     {
@@ -109,6 +170,41 @@ void ChartAxis::setAlignment(Qt::AlignmentFlag newPos)
         if (newPos >= Qt::AlignLeft && newPos <= Qt::AlignHCenter)
             labelPos = newPos;
     }
+
+    changed();
+}
+
+void ChartAxis::setPen(QPen newPen)
+{
+    labelPen = newPen;
+    changed();
+}
+
+void ChartAxis::setCell(qreal newCell)
+{
+    if (cellSize == newCell)
+        return;
+
+    cellSize = newCell;
+    changed();
+}
+
+void ChartAxis::setDivideThreshold(int newTr)
+{
+    divideThreshold = newTr;
+    changed();
+}
+
+void ChartAxis::setDivideLabel(bool enabled)
+{
+    divide = enabled;
+    changed();
+}
+
+void ChartAxis::changed()
+{
+    if (chart != NULL)
+        chart->invalidateLayers(PlainChart::AxisLayer);
 }
 
 qreal ChartAxis::coordFromPixel(int pixel) const
@@ -174,13 +270,14 @@ void ChartAxis::paint(QPainter* painter)
 
     const int pos = lbPos;
     const bool drawDivided = !chart->data->isEmpty() && isDivided();
-    const QVector<qreal>& points = calculatePoints();
-    QVector<QPair<QPointF, QPointF> > gridPoints;
+    const QVector<qreal>& points = tickGen.ticks(min(), max(), cellSize);
+    updateLabels(points, drawDivided);
+    gridLines.resize(points.size());
 
     for (int i = 0; i < points.size(); ++i)
     {
         const qreal coord = points[i];
-        const QString text = QString::number(drawDivided ? qRound(coord / 1000) : coord);
+        const QString& text = labelTexts.at(i);
         int pixel = pixelFromCoord(coord);
 
         if (i == 0)
@@ -195,12 +292,12 @@ void ChartAxis::paint(QPainter* painter)
         if (isHoriz)
         {
             point = QPointF(pixel, pos);
-            gridPoints.append(qMakePair(QPointF(pixel, 0), QPointF(pixel, chart->height())));
+            gridLines[i] = QLineF(pixel, 0, pixel, chart->height());
         }
         else
         {
             point = QPointF(pos, pixel);
-            gridPoints.append(qMakePair(QPointF(0, pixel), QPointF(chart->width(), pixel)));
+            gridLines[i] = QLineF(0, pixel, chart->width(), pixel);
         }
 
         //тут можно добавить отрисовку тиков осей, если она будет нужна
@@ -209,31 +306,25 @@ void ChartAxis::paint(QPainter* painter)
         chart->text->addAbsText(point, text);
     }
 
-    grd->paint(painter, gridPoints);
+    grd->paint(painter, gridLines, chart->height());
 
     painter->setTransform(oldTr);
     painter->setWindow(oldWindow);
 }
 
-QVector<qreal> ChartAxis::calculatePoints()
+void ChartAxis::updateLabels(const QVector<qreal>& points, bool divided)
 {
-    QVector<qreal> points;
-
-    const qreal cell_size = cellSize;
-    const qreal start = 0;
-
-    points.append(start);
-
-    for (qreal i = start + cell_size; i <= max(); i += cell_size)
-        points.append(i);
+    if (points == labelCoords && divided == labelDivided)
+        return;
 
-    for (qreal i = start - cell_size; i >= min(); i -= cell_size)
-        points.append(i);
+    labelCoords = points;
+    labelDivided = divided;
+    labelTexts.resize(points.size());
 
-    return points;
+    for (int i = 0; i < points.size(); ++i)
+        labelTexts[i] = QString::number(divided ? qRound(points.at(i) / 1000) : points.at(i));
 }
 
-
 void ChartRange::setRangeImpl(double newS, double newF)
 {
     st = newS; fn = newF;
@@ -2,15 +2,19 @@
 #define CHARTAXIS_H
 
 #include "chartlayeritem.h"
+#include "chartticks.h"
 
+#include <QImage>
+#include <QLineF>
 #include <QWidget>
 
 class PlainChart;
+class ChartAxis;
 
 class ChartRange
 {
 public:
-    ChartRange() { }
+    ChartRange() : st(0), fn(0), mn(0), mx(0), sz(0), scl(0) { }
     explicit ChartRange(double newStart, double newFinish) : st(newStart), fn(newFinish) { }
 
     double getSpan() const { return qAbs(fn - st); }
@@ -40,22 +44,35 @@ private:
 class ChartGrid
 {
 public:
-    explicit ChartGrid();
+    explicit ChartGrid(ChartAxis* owner = NULL);
 
-    void paint(QPainter* painter, const QVector<QPair<QPointF, QPointF> >& points);
+    //lines[0] - нулевая линия
+    void paint(QPainter* painter, const QVector<QLineF>& lines, int height);
 
-    void setZeroLinePen(QPen newPen) { zeroLinePen = newPen; }
-    void setGridPen(QPen newPen) { gridPen = newPen; }
-    void setAnglePen(QPen newPen) { anglePen = newPen; }
-    void drawAngles(bool enabled) { drawAngle = enabled; }
+    void setZeroLinePen(QPen newPen) { zeroLinePen = newPen; changed(); }
+    void setGridPen(QPen newPen) { gridPen = newPen; changed(); }
+    void setAnglePen(QPen newPen) { anglePen = newPen; changed(); }
+    void drawAngles(bool enabled) { drawAngle = enabled; changed(); }
+    void setCached(bool enabled);
 
 private:
     void initPainter(QPainter* painter);
+    void paintLines(QPainter* painter, const QVector<QLineF>& lines, int height);
+    void changed();
 
+    //ось, в слое которой рисуется сетка
+    ChartAxis* axis;
     QPen zeroLinePen;
     QPen gridPen;
     QPen anglePen;
     bool drawAngle;
+
+    //растр сетки; линии определяются диапазоном, шагом и размером виджета,
+    //поэтому по ним и проверяется актуальность
+    QImage cache;
+    QVector<QLineF> cacheLines;
+    int cacheHeight;
+    bool cached, valid;
 };
 
 
@@ -72,10 +89,10 @@ public:
     void setSize(int newSize);
     void setOffset(qreal newOffset) { offst = newOffset; }
     void setShift(qreal newShift) { shft = newShift; }
-    void setPen(QPen newPen) { labelPen = newPen; }
-    void setCell(qreal newCell) { cellSize = newCell; }
-    void setDivideThreshold(int newTr) { divideThreshold = newTr; }
-    void setDivideLabel(bool enabled) { divide = enabled; }
+    void setPen(QPen newPen);
+    void setCell(qreal newCell);
+    void setDivideThreshold(int newTr);
+    void setDivideLabel(bool enabled);
     void setNumberOfTicks(int newT) { numOfTicks = newT; }
     void setNumberOfSubTicks(int newT) { numOfSubTicks = newT; }
 
@@ -93,8 +110,9 @@ private:
     void initPainter(QPainter* painter);
     bool isDivided() const;
     void updateLabelPos();
+    void changed();
 
-    QVector<qreal> calculatePoints();
+    void updateLabels(const QVector<qreal>& points, bool divided);
 
     ChartGrid* grd;
     PlainChart* chart;
@@ -104,6 +122,15 @@ private:
     int lbPos, divideThreshold, prev;
     bool isHoriz, isInvert, divide;
     qreal offst, shft, cellSize;
+    ChartTicks tickGen;
+    QVector<QLineF> gridLines;
+
+    //подписи последнего набора делений, пересоздаются только при его изменении
+    QVector<qreal> labelCoords;
+    QVector<QString> labelTexts;
+    bool labelDivided;
+
+    friend class ChartGrid;
 };
 
 #endif // CHARTAXIS_H
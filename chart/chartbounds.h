@@ -0,0 +1,35 @@
+#ifndef CHARTBOUNDS_H
+#define CHARTBOUNDS_H
+
+#include <QtGlobal>
+
+#include <algorithm>
+#include <limits>
+
+//габариты набора данных: [minX, maxX] x [minY, maxY]
+struct ChartBounds
+{
+    ChartBounds() : minX(0), maxX(0), minY(0), maxY(0) { }
+    ChartBounds(qreal x_min, qreal x_max, qreal y_min, qreal y_max)
+        : minX(x_min), maxX(x_max), minY(y_min), maxY(y_max) { }
+
+    //нейтральный элемент для unite()
+    static ChartBounds empty()
+    {
+        const qreal max = std::numeric_limits<qreal>::max();
+        return ChartBounds(max, -max, max, -max);
+    }
+
+    void unite(const ChartBounds& other)
+    {
+        minX = std::min(minX, other.minX);
+        maxX = std::max(maxX, other.maxX);
+        minY = std::min(minY, other.minY);
+        maxY = std::max(maxY, other.maxY);
+    }
+
+    qreal minX, maxX;
+    qreal minY, maxY;
+};
+
+#endif // CHARTBOUNDS_H
@@ -1,52 +1,145 @@
 #include "chartdata.h"
 #include "chartaxis.h"
+#include "chartkernels.h"
+#include "chartgeometry.h"
 #include "plainchart.h"
 
 #include <algorithm>
+#include <cmath>
 #include <limits>
 
 #include <QPainter>
+#include <QtConcurrent>
+
+//пирамида упрощения контуров: начальный допуск относительно диагонали контура,
+//рост допуска между уровнями и число вершин, которое дальше не упрощается
+static const qreal polygonMinTolerance = 1e-6;
+static const qreal polygonLevelFactor = 4.0;
+static const int polygonMinPoints = 16;
+
+//во сколько раз точек профиля должно быть больше столбцов пикселей для прореживания
+static const qreal routeLodRatio = 4.0;
+
+//минимальный размер набора точек, для которого строится пространственный индекс,
+//и размер, с которого индекс строится в фоне
+static const int indexThreshold = 4096;
+static const int backgroundIndexThreshold = 1 << 16;
+
+//минимальный размер траектории, для которой строится пирамида прореживания,
+//и во сколько раз блок выбранного уровня должен быть мельче столбца пикселей
+static const int pyramidThreshold = 1 << 16;
+static const qreal pyramidDetail = 4.0;
+//фоновое построение идет порциями, между ними проверяется, нужна ли еще пирамида
+static const int pyramidBuildStep = 1 << 18;
+
+static inline void calcBounds(ChartBounds& bounds, const QVector<QPointF>& vec)
+{
+    bounds = boundsOfPoints(vec.constData(), vec.size());
+}
+
+static inline void calcBounds(ChartBounds& bounds, const ChartSeries& series)
+{
+    //в кольцевом режиме экстремумы окна ведет само хранилище
+    if (series.capacity() > 0)
+        bounds = series.windowBounds();
+    else
+        bounds = series.bounds(0, series.size());
+}
+
+//обновление границ после дозаписи count точек в конец хранилища
+static inline void appendBounds(ChartBounds& bounds, const ChartSeries& series, int count)
+{
+    if (series.capacity() > 0)
+    {
+        bounds = series.windowBounds();
+        return;
+    }
+
+    const ChartBounds added = series.bounds(series.size() - count, count);
+
+    if (series.size() == count)
+        bounds = added;
+    else
+        bounds.unite(added);
+}
 
-static inline bool pointXCompare(QPointF first, QPointF second)
+static inline bool isSortedByX(const ChartSeries& series, int from, int count)
 {
-    return first.x() < second.x();
+    for (int i = from + 1; i < from + count; ++i)
+    {
+        if (series.x(i) < series.x(i-1))
+            return false;
+    }
+
+    return true;
 }
 
-static inline bool pointYCompare(QPointF first, QPointF second)
+//сохраняется ли упорядоченность по x после дозаписи count точек
+static inline bool isAppendSorted(const ChartSeries& series, int count)
 {
-    return first.y() < second.y();
+    const int tail = qMin(count + 1, series.size());
+
+    return isSortedByX(series, series.size() - tail, tail);
 }
 
-static inline void calcBounds(QVector<qreal>& old_bounds, const QVector<qreal>& vec)
+//индекс первой точки с x >= value (с x > value при upper) в упорядоченном хранилище
+static inline int searchX(const ChartSeries& series, qreal value, bool upper)
 {
-    old_bounds[0] = std::min(old_bounds[0], vec[0]);
-    old_bounds[1] = std::max(old_bounds[1], vec[1]);
-    old_bounds[2] = std::min(old_bounds[2], vec[2]);
-    old_bounds[3] = std::max(old_bounds[3], vec[3]);
+    int first = 0;
+    int count = series.size();
+
+    while (count > 0)
+    {
+        const int step = count / 2;
+        const qreal x = series.x(first + step);
+
+        if (x < value || (upper && x == value))
+        {
+            first += step + 1;
+            count -= step + 1;
+        }
+        else
+            count = step;
+    }
+
+    return first;
 }
 
-static inline void calcBounds(QVector<qreal>& bounds, const QVector<QPointF>& vec)
+void ChartDataItem::setExternalData(const qreal* x_data, const qreal* y_data, int count, int stride,
+                                    const std::shared_ptr<const void>& keep_alive,
+                                    const ChartDataHints& hints)
 {
-    bounds.clear();
+    Q_UNUSED(keep_alive);
+    Q_UNUSED(hints);
 
-#if __cplusplus > 199711L
-    const auto x_pair = (std::minmax_element(vec.begin(), vec.end(), pointXCompare));
-    const auto y_pair = (std::minmax_element(vec.begin(), vec.end(), pointYCompare));
+    //элементы без внешнего режима получают копию
+    QVector<QPointF> data;
+    data.reserve(count);
 
-    bounds << x_pair.first->x() << x_pair.second->x() << y_pair.first->y() << y_pair.second->y();
-#else
-    bounds << (std::min_element(vec.begin(), vec.end(), pointXCompare))->x();
-    bounds << (std::max_element(vec.begin(), vec.end(), pointXCompare))->x();
-    bounds << (std::min_element(vec.begin(), vec.end(), pointYCompare))->y();
-    bounds << (std::max_element(vec.begin(), vec.end(), pointYCompare))->y();
-#endif
+    for (int i = 0; i < count; ++i)
+        data.append(QPointF(x_data[i * stride], y_data[i * stride]));
+
+    setData(std::move(data));
+}
+
+void ChartDataItem::dataChanged()
+{
+    if (owner != NULL)
+        owner->invalidateRange();
+}
+
+void ChartDataItem::styleChanged()
+{
+    if (owner != NULL)
+        owner->invalidateLayer();
 }
 
 
 ChartData::ChartData(PlainChart* chart)
     : ChartLayerItem(),
     chart(chart),
-    hghtItem(NULL)
+    hghtItem(NULL),
+    rangeDirty(true)
 {
 
 }
@@ -55,20 +148,93 @@ void ChartData::paint(QPainter* painter)
 {
     const QTransform oldTr = painter->transform();
     const QRect oldWindow = painter->window();
+    const ChartProjection proj = projection();
 
-    initPainter(painter);
+    initPainter(painter, proj);
 
     for (int i = 0; i < mData.size(); ++i)
-    {
-        mData.at(i)->setParams(chart->xAxs->getSpan() / chart->xAxs->pixelSpan() * 4.0,
-                               chart->yAxs->getSpan() / chart->yAxs->pixelSpan() * 4.0);
-        mData.at(i)->paint(painter);
-    }
+        paintItem(painter, mData.at(i), proj);
 
     painter->setTransform(oldTr);
     painter->setWindow(oldWindow);
 }
 
+ChartProjection ChartData::projection() const
+{
+    const ChartAxis* x_axis = chart->xAxs;
+    const ChartAxis* y_axis = chart->yAxs;
+
+    ChartProjection proj;
+    proj.xOffset = x_axis->offset();
+    proj.yOffset = y_axis->offset();
+    proj.xShift = x_axis->shift();
+    proj.yShift = y_axis->shift();
+    proj.xSpan = x_axis->getSpan();
+    proj.ySpan = y_axis->getSpan();
+    proj.xScale = x_axis->scale();
+    proj.yScale = y_axis->scale();
+    proj.xPixels = x_axis->pixelSpan();
+    proj.yPixels = y_axis->pixelSpan();
+    proj.xInverted = x_axis->isInverted();
+    proj.yInverted = y_axis->isInverted();
+    proj.window = QRectF(x_axis->min(), y_axis->min(), x_axis->max() - x_axis->min(), y_axis->max() - y_axis->min());
+
+    return proj;
+}
+
+QVector<ChartDataItem*> ChartData::cloneItems() const
+{
+    QVector<ChartDataItem*> items;
+    items.reserve(mData.size());
+
+    for (int i = 0; i < mData.size(); ++i)
+    {
+        //индекс строится один раз здесь, а не в каждой копии полосы каждого кадра
+        mData.at(i)->prepare();
+
+        ChartDataItem* item = mData.at(i)->clone();
+        item->owner = NULL;
+        items.append(item);
+    }
+
+    return items;
+}
+
+void ChartData::paintItem(QPainter* painter, ChartDataItem* item, const ChartProjection& proj, const QRectF& clip)
+{
+    applyProjection(item, proj);
+
+    if (!clip.isNull())
+        item->setClip(clip);
+
+    item->paint(painter);
+}
+
+void ChartData::prepareItem(ChartDataItem* item, const ChartProjection& proj, qreal ratio)
+{
+    applyProjection(item, proj);
+    item->prepareFrame(pixelTransform(proj), ratio);
+}
+
+void ChartData::applyProjection(ChartDataItem* item, const ChartProjection& proj)
+{
+    item->setParams(proj.xSpan / proj.xPixels * 4.0, proj.ySpan / proj.yPixels * 4.0);
+    item->setViewport(proj.window, proj.xScale, proj.yScale);
+    item->yShift = proj.yShift;
+}
+
+void ChartData::invalidateRange()
+{
+    rangeDirty = true;
+    invalidateLayer();
+}
+
+void ChartData::invalidateLayer()
+{
+    if (chart != NULL)
+        chart->invalidateLayers(PlainChart::DataLayer);
+}
+
 ChartDataItem* ChartData::createItem(DataType type)
 {
     ChartDataItem* dataItem;
@@ -82,14 +248,18 @@ ChartDataItem* ChartData::createItem(DataType type)
     else
         dataItem = new ChartPointData();
 
+    dataItem->owner = this;
     mData.append(dataItem);
+    invalidateRange();
 
     return dataItem;
 }
 
 void ChartData::addDataItem(ChartDataItem* item)
 {
+    item->owner = this;
     mData.append(item);
+    invalidateRange();
 }
 
 ChartDataItem* ChartData::itemAt(int index)
@@ -116,6 +286,7 @@ void ChartData::clearData()
     }
 
     mData.clear();
+    invalidateRange();
 }
 
 bool ChartData::isEmpty() const
@@ -123,49 +294,56 @@ bool ChartData::isEmpty() const
     return mData.isEmpty();
 }
 
-const QVector<qreal> ChartData::range() const
+const ChartBounds& ChartData::range() const
 {
-    QVector<qreal> bounds = QVector<qreal>()
-                            << std::numeric_limits<qreal>::max() << -std::numeric_limits<qreal>::max()
-                            << std::numeric_limits<qreal>::max() << -std::numeric_limits<qreal>::max();
+    if (!rangeDirty)
+        return cachedRange;
+
+    ChartBounds bounds = ChartBounds::empty();
 
     for (int i = 0; i < mData.size(); ++i)
-        calcBounds(bounds, mData.at(i)->range());
+        bounds.unite(mData.at(i)->range());
 
-    if (qRound(bounds.at(0)) == qRound(bounds.at(1)))
+    if (qRound(bounds.minX) == qRound(bounds.maxX))
     {
-        bounds[0] -= 2.5;
-        bounds[1] += 2.5;
+        bounds.minX -= 2.5;
+        bounds.maxX += 2.5;
     }
 
-    if (qRound(bounds.at(2)) == qRound(bounds.at(3)))
+    if (qRound(bounds.minY) == qRound(bounds.maxY))
     {
-        bounds[2] -= 2.5;
-        bounds[3] += 2.5;
+        bounds.minY -= 2.5;
+        bounds.maxY += 2.5;
     }
 
-    return bounds;
+    cachedRange = bounds;
+    rangeDirty = false;
+
+    return cachedRange;
 }
 
-void ChartData::initPainter(QPainter* painter)
+void ChartData::initPainter(QPainter* painter, const ChartProjection& proj)
 {
-    const qreal x_offset = chart->xAxs->offset();
-    const qreal y_offset = chart->yAxs->offset();
-    const qreal x_span = chart->xAxs->getSpan();
-    const qreal y_span = chart->yAxs->getSpan();
-    const qreal x_shift = chart->xAxs->shift();
-    const qreal y_shift = chart->yAxs->shift();
-    const int x_scale = (chart->xAxs->isInverted()) ? -1 : 1;
-    const int y_scale = (chart->yAxs->isInverted()) ? -1 : 1;
-
-    //make it relative
-    const QTransform transform = QTransform().translate(x_offset , y_offset).scale(x_scale, y_scale);
-    const QRect window(x_shift, y_shift, x_span, y_span);
+    //логическое окно совпадает с областью вывода в пикселях, а координаты данных
+    //переводятся в пиксели дробным преобразованием - границы вида не округляются
+    painter->setWindow(QRect(QPoint(0, 0), painter->viewport().size()));
+    painter->setTransform(pixelTransform(proj));
+}
 
-    //перемещаем начало координат в нужную позицию и направляем оси вправо и вверх
-    //задаем логическую систему координат
-    painter->setTransform(transform);
-    painter->setWindow(window);
+QTransform ChartData::pixelTransform(const ChartProjection& proj)
+{
+    if (proj.xSpan == 0 || proj.ySpan == 0)
+        return QTransform();
+
+    //сдвигаем начало координат, направляем оси вправо и вверх и переводим
+    //единицы данных в пиксели
+    const qreal x_factor = proj.xPixels / proj.xSpan;
+    const qreal y_factor = proj.yPixels / proj.ySpan;
+    const int x_scale = (proj.xInverted) ? -1 : 1;
+    const int y_scale = (proj.yInverted) ? -1 : 1;
+
+    return QTransform(x_scale * x_factor, 0, 0, y_scale * y_factor,
+                      (proj.xOffset - proj.xShift) * x_factor, (proj.yOffset - proj.yShift) * y_factor);
 }
 
 
@@ -180,10 +358,47 @@ void ChartPolygonData::paint(QPainter* painter)
 {
     mainPen.setWidthF(hgt / 4);
 
-    painter->setBrush(mainBrush);
-    painter->setPen(mainPen);
+    //допуск упрощения - полпикселя по более подробной оси
+    const qreal tolerance = (xUnit > 0 && yUnit > 0) ? qMin(xUnit, yUnit) / 2 : 0;
+
+    const qreal pad_x = mainPen.widthF() + 2 * xUnit;
+    const qreal pad_y = mainPen.widthF() + 2 * yUnit;
+
+    for (int i = 0; i < shapes.size(); ++i)
+    {
+        const Shape& shape = shapes.at(i);
+        const ChartBounds& box = shape.bounds;
+
+        QPen pen = shape.styled ? stylePairs.at(i).first : mainPen;
+        pen.setWidthF(mainPen.widthF());
+
+        //отсекаем по расширенной области, чтобы ребра, появившиеся на ее границе,
+        //вместе с обводкой оставались за пределами экрана
+        const QRectF area = strokeClip(pen).adjusted(-pad_x, -pad_y, pad_x, pad_y);
+
+        const bool outside = box.maxX < area.left() || box.minX > area.right()
+                || box.maxY < area.top() || box.minY > area.bottom();
+        const bool inside = box.minX >= area.left() && box.maxX <= area.right()
+                && box.minY >= area.top() && box.maxY <= area.bottom();
+
+        if (!area.isEmpty() && outside)
+            continue;
+
+        painter->setPen(pen);
+        painter->setBrush(shape.styled ? stylePairs.at(i).second : mainBrush);
 
-    painter->drawPolygon(polygs, Qt::OddEvenFill);
+        const QPolygonF& outline = shape.levels.at(levelFor(shape, tolerance));
+
+        if (area.isEmpty() || inside)
+            painter->drawPolygon(outline, Qt::OddEvenFill);
+        else
+        {
+            clipPolygon(outline, area, clipped, clipBuffer);
+
+            if (clipped.size() >= 3)
+                painter->drawPolygon(clipped, Qt::OddEvenFill);
+        }
+    }
 }
 
 void ChartPolygonData::setData(const QVector<QPointF>& pols)
@@ -191,27 +406,116 @@ void ChartPolygonData::setData(const QVector<QPointF>& pols)
     if (pols.size() == 0)
         return;
 
-    QPolygonF polys = static_cast<QPolygonF>(pols);
+    setPolys(QPolygonF(pols));
+}
+
+void ChartPolygonData::setData(QVector<QPointF>&& pols)
+{
+    if (pols.size() == 0)
+        return;
+
+    QPolygonF polygon;
+    static_cast<QVector<QPointF>&>(polygon) = std::move(pols);
+    setPolys(std::move(polygon));
+}
+
+void ChartPolygonData::addPolygon(const QVector<QPointF>& polygon)
+{
+    if (polygon.size() == 0)
+        return;
 
-    setPolys(polys);
-    calcBounds(bounds, polys);
+    appendShape(QPolygonF(polygon));
+    stylePairs.append(qMakePair(QPen(), QBrush()));
+    updatePolys();
+}
+
+void ChartPolygonData::addPolygon(const QVector<QPointF>& polygon, const QPen& pen, const QBrush& brush)
+{
+    if (polygon.size() == 0)
+        return;
+
+    appendShape(QPolygonF(polygon));
+    shapes.last().styled = true;
+    stylePairs.append(qMakePair(pen, brush));
+    updatePolys();
 }
 
 void ChartPolygonData::clearData()
 {
-    polygs.clear();
-    bounds.clear();
-    bounds.resize(4);
+    shapes.clear();
+    stylePairs.clear();
+    bounds = ChartBounds();
+    dataChanged();
 }
 
-void ChartPolygonData::setPolys(const QPolygonF& pols)
+void ChartPolygonData::setPolys(QPolygonF pols)
 {
-    polygs = pols;
+    shapes.clear();
+    stylePairs.clear();
+
+    appendShape(std::move(pols));
+    stylePairs.append(qMakePair(QPen(), QBrush()));
+    updatePolys();
+}
+
+void ChartPolygonData::appendShape(QPolygonF polygon)
+{
+    Shape shape;
+    shape.styled = false;
+    calcBounds(shape.bounds, polygon);
+
+    shape.levels.append(std::move(polygon));
+    shape.tolerances.append(0);
+
+    //каждый уровень упрощается из предыдущего с вчетверо большим допуском,
+    //пока вершин не останется совсем мало; погрешности уровней складываются
+    const qreal diagonal = qSqrt(qPow(shape.bounds.maxX - shape.bounds.minX, 2) + qPow(shape.bounds.maxY - shape.bounds.minY, 2));
+    qreal tolerance = diagonal * polygonMinTolerance;
+    qreal error = 0;
+
+    while (tolerance > 0 && tolerance < diagonal && shape.levels.last().size() > polygonMinPoints)
+    {
+        QPolygonF level = simplifyPolygon(shape.levels.last(), tolerance);
+
+        if (level.size() < shape.levels.last().size())
+        {
+            error += tolerance;
+            shape.levels.append(level);
+            shape.tolerances.append(error);
+        }
+
+        tolerance *= polygonLevelFactor;
+    }
+
+    shapes.append(shape);
+}
+
+void ChartPolygonData::updatePolys()
+{
+    bounds = shapes.first().bounds;
+
+    for (int i = 1; i < shapes.size(); ++i)
+        bounds.unite(shapes.at(i).bounds);
+
+    dataChanged();
+}
+
+int ChartPolygonData::levelFor(const Shape& shape, qreal tolerance) const
+{
+    int level = 0;
+
+    while (level + 1 < shape.tolerances.size() && shape.tolerances.at(level + 1) <= tolerance)
+        ++level;
+
+    return level;
 }
 
 
 ChartTrajectoryData::ChartTrajectoryData()
-    : ChartDataItem()
+    : ChartDataItem(),
+    lodRatio(4.0),
+    xSorted(false),
+    pyramidPending(false)
 {
     mainPen = QPen(Qt::blue, 1, Qt::SolidLine);
     mainBrush = QBrush(Qt::blue);
@@ -226,9 +530,18 @@ void ChartTrajectoryData::paint(QPainter* painter)
 
     if (traj.size() == 1)
         painter->drawRect(QRectF(traj.at(0).x() - wdt / 2, traj.at(0).y() - hgt / 2, wdt, hgt));
-    else
+    else if (!paintDecimated(painter))
     {
-        for (int j = 1; j < traj.size(); ++j)
+        int first = 0, last = traj.size();
+
+        //отрезки упорядоченной траектории вне clip (с запасом на толщину пера) не рисуем
+        if (xSorted && !clip.isEmpty())
+        {
+            const qreal pad = mainPen.widthF() + 2 * xUnit;
+            clipRange(clip.left() - pad, clip.right() + pad, first, last);
+        }
+
+        for (int j = first + 1; j < last; ++j)
             painter->drawLine(traj.at(j-1), traj.at(j));
     }
 }
@@ -239,30 +552,253 @@ void ChartTrajectoryData::setData(const QVector<QPointF>& data)
         return;
 
     setTraj(data);
-    calcBounds(bounds, data);
+}
+
+void ChartTrajectoryData::setData(QVector<QPointF>&& data)
+{
+    if (data.size() == 0)
+        return;
+
+    setTraj(std::move(data));
+}
+
+void ChartTrajectoryData::setExternalData(const qreal* x_data, const qreal* y_data, int count, int stride,
+                                          const std::shared_ptr<const void>& keep_alive,
+                                          const ChartDataHints& hints)
+{
+    if (count <= 0)
+        return;
+
+    traj.setExternal(x_data, y_data, count, stride, keep_alive);
+    updateTraj(hints);
+}
+
+void ChartTrajectoryData::appendData(const QVector<QPointF>& data)
+{
+    appendTraj(data.constData(), data.size());
+}
+
+void ChartTrajectoryData::appendPoint(const QPointF& point)
+{
+    appendTraj(&point, 1);
+}
+
+void ChartTrajectoryData::setCapacity(int newCapacity)
+{
+    traj.setCapacity(newCapacity);
+
+    if (newCapacity > 0 && !traj.isEmpty())
+        bounds = traj.windowBounds();
+
+    //вытеснение сдвигает номера точек
+    startPyramid();
+    dataChanged();
+}
+
+void ChartTrajectoryData::appendTraj(const QPointF* data, int count)
+{
+    if (count <= 0)
+        return;
+
+    const bool was_empty = traj.isEmpty();
+
+    traj.append(data, count);
+    appendBounds(bounds, traj, count);
+    xSorted = (was_empty || xSorted) && isAppendSorted(traj, count);
+    updatePyramid();
+    dataChanged();
+}
+
+bool ChartTrajectoryData::paintDecimated(QPainter* painter)
+{
+    //прореживание возможно только для траекторий, упорядоченных по x
+    if (lodRatio <= 0 || !xSorted || xUnit <= 0 || view.width() <= 0)
+        return false;
+
+    int first, last;
+    clipRange(view.left(), view.right(), first, last);
+
+    const int count = last - first;
+    const qreal columns = view.width() / xUnit;
+
+    if (count < lodRatio * columns)
+        return false;
+
+    //для части окна (тайла) прореживаем только ее столбцы с запасом на толщину пера;
+    //сетка столбцов привязана к левому краю окна, поэтому вершины внутри тайла
+    //совпадают с прореживанием всего окна
+    const QRectF& range = strokeClip(mainPen);
+
+    if (range != view)
+    {
+        const qreal origin = view.left();
+        const qreal pad = mainPen.widthF() + 2 * xUnit;
+        const qreal left = origin + qFloor((range.left() - pad - origin) / xUnit) * xUnit;
+        const qreal right = origin + qCeil((range.right() + pad - origin) / xUnit) * xUnit;
+
+        clipRange(qMax(left, view.left()), qMin(right, view.right()), first, last);
+    }
+
+    //точек на столбец много - вместо всех точек прореживаем опорные точки
+    //уровня пирамиды с блоками заметно мельче столбца
+    const ChartPyramid* pyr = readyPyramid();
+    const int level = (pyr != NULL && pyr->count() == traj.size()) ?
+                pyr->levelFor(count / columns / pyramidDetail) : -1;
+
+    if (level >= 0)
+        pyr->collect(traj, level, first, last, lodPoints);
+
+    if (level >= 0 && !lodPoints.isEmpty())
+    {
+        QPointF* points = lodPoints.data();
+        lodSeries.setExternal(&points->rx(), &points->ry(), lodPoints.size(), 2, std::shared_ptr<const void>());
+
+        decimateByColumns(lodTraj, lodSeries, 0, lodPoints.size(), view.left(), xUnit);
+    }
+    else
+        decimateByColumns(lodTraj, traj, first, last, view.left(), xUnit);
+
+    painter->drawPolyline(lodTraj);
+
+    return true;
+}
+
+void ChartTrajectoryData::clipRange(qreal left, qreal right, int& first, int& last) const
+{
+    //точки диапазона и по одной соседней с каждой стороны
+    first = qMax(searchX(traj, left, false) - 1, 0);
+    last = qMin(searchX(traj, right, true) + 1, traj.size());
+}
+
+void ChartTrajectoryData::startPyramid()
+{
+    resetPyramid();
+
+    //пирамиду по номерам точек можно вести только для упорядоченной серии без вытеснения
+    if (!xSorted || traj.capacity() > 0 || traj.size() < pyramidThreshold)
+        return;
+
+    //копия разделяет буферы с traj, дозапись во время построения их отсоединит.
+    //Построение прекращается, когда метку отпустят элемент и все его копии
+    pyramidToken = std::make_shared<int>(0);
+    pyramidBuild = QtConcurrent::run(&ChartTrajectoryData::buildPyramid, traj,
+                                     std::weak_ptr<const void>(pyramidToken));
+    pyramidPending = true;
+}
+
+void ChartTrajectoryData::resetPyramid()
+{
+    pyramid.reset();
+    pyramidToken.reset();
+    pyramidBuild = QFuture<std::shared_ptr<ChartPyramid> >();
+    pyramidPending = false;
+}
+
+void ChartTrajectoryData::updatePyramid()
+{
+    if (!xSorted || traj.capacity() > 0)
+    {
+        resetPyramid();
+        return;
+    }
+
+    if (readyPyramid() == NULL)
+    {
+        if (!pyramidPending)
+            startPyramid();
+        return;
+    }
+
+    //пирамиду может читать копия элемента в потоке отрисовки
+    if (pyramid.use_count() > 1)
+        pyramid = std::make_shared<ChartPyramid>(*pyramid);
+
+    pyramid->update(traj);
+}
+
+const ChartPyramid* ChartTrajectoryData::readyPyramid()
+{
+    if (pyramidPending && pyramidBuild.isFinished())
+    {
+        pyramid = pyramidBuild.result();
+        pyramidBuild = QFuture<std::shared_ptr<ChartPyramid> >();
+        pyramidToken.reset();
+        pyramidPending = false;
+    }
+
+    return pyramid.get();
+}
+
+std::shared_ptr<ChartPyramid> ChartTrajectoryData::buildPyramid(ChartSeries series, std::weak_ptr<const void> token)
+{
+    std::shared_ptr<ChartPyramid> result = std::make_shared<ChartPyramid>();
+    ChartSeries part;
+
+    //пирамида досчитывается по растущему началу серии - между порциями
+    //построение можно прервать, если данные уже заменены
+    for (int size = 0; size < series.size(); )
+    {
+        if (token.expired())
+            return std::shared_ptr<ChartPyramid>();
+
+        size = qMin(size + pyramidBuildStep, series.size());
+        part.setExternal(series.xData(), series.yData(), size, series.stride(), std::shared_ptr<const void>());
+        result->update(part);
+    }
+
+    return result;
 }
 
 void ChartTrajectoryData::setColor(Qt::GlobalColor trajectoryColor)
 {
     mainPen.setColor(trajectoryColor);
     mainBrush.setColor(trajectoryColor);
+    styleChanged();
 }
 
-void ChartTrajectoryData::setTraj(const QVector<QPointF>& newTraj)
+void ChartTrajectoryData::setTraj(QVector<QPointF> newTraj)
 {
-    traj = newTraj;
+    traj.setData(std::move(newTraj));
+    updateTraj();
+}
+
+void ChartTrajectoryData::updateTraj(const ChartDataHints& hints)
+{
+    //известные заранее свойства не пересчитываются полным проходом;
+    //при заданной емкости часть точек вытеснена и габариты другие
+    if (hints.hasBounds && traj.capacity() == 0)
+        bounds = hints.bounds;
+    else
+        calcBounds(bounds, traj);
+
+    xSorted = hints.sortedByX || isSortedByX(traj, 0, traj.size());
+    startPyramid();
+    dataChanged();
+}
+
+void ChartTrajectoryData::setColumnStorage(bool enabled)
+{
+    traj.setLayout(enabled ? ChartSeries::Columnar : ChartSeries::Interleaved);
 }
 
 void ChartTrajectoryData::clearData()
 {
     traj.clear();
-    bounds.clear();
-    bounds.resize(4);
+    lodTraj.clear();
+    xSorted = false;
+    resetPyramid();
+    bounds = ChartBounds();
+    dataChanged();
 }
 
 
 ChartRouteData::ChartRouteData()
-    : ChartDataItem()
+    : ChartDataItem(),
+    lastSegment(-1),
+    interpolate(false),
+    xSorted(false),
+    fillLower(0), fillLeft(0), fillRight(0), fillUnit(0),
+    fillDirty(true)
 {
     mainPen = QPen(Qt::darkGreen, 1, Qt::SolidLine);
     mainBrush = QBrush(Qt::green);
@@ -272,24 +808,100 @@ void ChartRouteData::paint(QPainter* painter)
 {
     mainPen.setWidthF(hgt / 4);
 
-    QVector<QPointF> prof = profile;
+    if (profile.isEmpty())
+        return;
 
-    const int rect_top = painter->window().top();
-    const int sign = ((bounds[2] - rect_top * 4) <= 0) ? -1 : 1;
+    const qreal rect_top = yShift;
+    const int sign = ((bounds.minY - rect_top * 4) <= 0) ? -1 : 1;
     const qreal lower = sign * rect_top;
 
-    prof.prepend(QPointF(prof.first().x(), lower));
-    prof.append(QPointF(prof.last().x(), lower));
+    updateFill(lower);
 
-    //рисуем профиль маршрута
+    //рисуем профиль маршрута (в общем случае невыпуклый)
     painter->setBrush(mainBrush);
     painter->setPen(mainPen);
-    painter->drawConvexPolygon(prof);
+    painter->drawPolygon(fill);
+}
+
+void ChartRouteData::updateFill(qreal lower)
+{
+    //упорядоченный профиль прореживается по столбцам пикселей видимого диапазона,
+    //поэтому контур зависит еще и от окна и масштаба по x
+    const bool visible_only = xSorted && xUnit > 0 && view.width() > 0;
+    const qreal left = visible_only ? view.left() : 0;
+    const qreal right = visible_only ? view.right() : 0;
+    const qreal unit = visible_only ? xUnit : 0;
+
+    if (!fillDirty && lower == fillLower && left == fillLeft && right == fillRight && unit == fillUnit)
+        return;
+
+    int first = 0, last = profile.size();
+
+    if (visible_only)
+    {
+        first = qMax(searchX(profile, left, false) - 1, 0);
+        last = qMin(searchX(profile, right, true) + 1, profile.size());
+    }
+
+    fill.clear();
+    fill.append(QPointF(profile.at(first).x(), lower));
+
+    if (visible_only && last - first >= routeLodRatio * (view.width() / xUnit))
+    {
+        //в каждом столбце остаются первая, последняя, нижняя и верхняя точки -
+        //пики рельефа сохраняются
+        decimateByColumns(lodFill, profile, first, last, left, unit);
+        fill += lodFill;
+    }
+    else
+    {
+        fill.reserve(last - first + 2);
+
+        for (int i = first; i < last; ++i)
+            fill.append(profile.at(i));
+    }
+
+    fill.append(QPointF(profile.at(last - 1).x(), lower));
+
+    fillLower = lower;
+    fillLeft = left;
+    fillRight = right;
+    fillUnit = unit;
+    fillDirty = false;
 }
 
-void ChartRouteData::setRoute(const QVector<QPointF>& prof)
+void ChartRouteData::setRoute(QVector<QPointF> prof)
 {
-    profile = prof;
+    profile.setData(std::move(prof));
+    updateRoute();
+}
+
+void ChartRouteData::updateRoute(const ChartDataHints& hints)
+{
+    if (hints.hasBounds && profile.capacity() == 0)
+        bounds = hints.bounds;
+    else
+        calcBounds(bounds, profile);
+
+    xSorted = hints.sortedByX || isSortedByX(profile, 0, profile.size());
+    lastSegment = -1;
+    fillDirty = true;
+    dataChanged();
+}
+
+void ChartRouteData::appendRoute(const QPointF* data, int count)
+{
+    if (count <= 0)
+        return;
+
+    const bool was_empty = profile.isEmpty();
+
+    profile.append(data, count);
+    appendBounds(bounds, profile, count);
+    xSorted = (was_empty || xSorted) && isAppendSorted(profile, count);
+    lastSegment = -1;
+    fillDirty = true;
+    dataChanged();
 }
 
 void ChartRouteData::setData(const QVector<QPointF>& prof)
@@ -298,32 +910,132 @@ void ChartRouteData::setData(const QVector<QPointF>& prof)
         return;
 
     setRoute(prof);
-    calcBounds(bounds, prof);
+}
+
+void ChartRouteData::setData(QVector<QPointF>&& prof)
+{
+    if (prof.size() <= 1)
+        return;
+
+    setRoute(std::move(prof));
+}
+
+void ChartRouteData::setExternalData(const qreal* x_data, const qreal* y_data, int count, int stride,
+                                     const std::shared_ptr<const void>& keep_alive,
+                                     const ChartDataHints& hints)
+{
+    if (count <= 1)
+        return;
+
+    profile.setExternal(x_data, y_data, count, stride, keep_alive);
+    updateRoute(hints);
+}
+
+void ChartRouteData::appendData(const QVector<QPointF>& prof)
+{
+    appendRoute(prof.constData(), prof.size());
+}
+
+void ChartRouteData::appendPoint(const QPointF& point)
+{
+    appendRoute(&point, 1);
+}
+
+void ChartRouteData::setCapacity(int newCapacity)
+{
+    profile.setCapacity(newCapacity);
+    lastSegment = -1;
+    fillDirty = true;
+
+    if (newCapacity > 0 && !profile.isEmpty())
+        bounds = profile.windowBounds();
+
+    dataChanged();
+}
+
+void ChartRouteData::setColumnStorage(bool enabled)
+{
+    profile.setLayout(enabled ? ChartSeries::Columnar : ChartSeries::Interleaved);
 }
 
 void ChartRouteData::clearData()
 {
     profile.clear();
-    bounds.clear();
-    bounds.resize(4);
+    lastSegment = -1;
+    fillDirty = true;
+    xSorted = false;
+    bounds = ChartBounds();
+    dataChanged();
 }
 
 qreal ChartRouteData::heightValue(qreal x_value) const
 {
-    qreal result = 0.0;
+    const int segment = segmentAt(x_value);
+
+    if (segment < 0)
+        return 0.0;
+
+    const QPointF left = profile.at(segment);
+
+    if (!interpolate)
+        return left.y();
+
+    const QPointF right = profile.at(segment + 1);
+
+    return left.y() + (right.y() - left.y()) * (x_value - left.x()) / (right.x() - left.x());
+}
+
+bool ChartRouteData::segmentContains(int index, qreal x_value) const
+{
+    if (index < 0 || index >= profile.size() - 1)
+        return false;
+
+    return profile.x(index) <= x_value && profile.x(index+1) > x_value;
+}
 
-    for (int i = 0; i < profile.size() - 1; ++i)
+int ChartRouteData::segmentAt(qreal x_value) const
+{
+    //неупорядоченный профиль - прежний полный перебор, выигрывает последний подходящий отрезок
+    if (!xSorted)
     {
-        if (profile.at(i).x() <= x_value && profile.at(i+1).x() > x_value)
-            result = profile.at(i).y();
+        int result = -1;
+
+        for (int i = 0; i < profile.size() - 1; ++i)
+        {
+            if (segmentContains(i, x_value))
+                result = i;
+        }
+
+        return result;
     }
 
-    return result;
+    //курсор обычно смещается на соседний отрезок, поэтому сначала проверяем их
+    for (int i = lastSegment - 1; lastSegment >= 0 && i <= lastSegment + 1; ++i)
+    {
+        if (segmentContains(i, x_value))
+        {
+            lastSegment = i;
+            return i;
+        }
+    }
+
+    if (profile.isEmpty() || x_value < profile.first().x() || x_value >= profile.last().x())
+        return -1;
+
+    lastSegment = searchX(profile, x_value, true) - 1;
+
+    return lastSegment;
 }
 
 
 ChartPointData::ChartPointData()
     : ChartDataItem(),
+    indexDirty(false),
+    indexPending(false),
+    paintMode(MarkerMode),
+    densityThreshold(0.1),
+    framePrepared(false),
+    frameDense(false),
     zeroPointPen(QPen(Qt::green, 5, Qt::SolidLine)),
     zeroPointBr(Qt::green)
 {
@@ -333,24 +1045,158 @@ ChartPointData::ChartPointData()
 
 void ChartPointData::paint(QPainter* painter)
 {
-    zeroPointPen.setWidthF(hgt / 2);
-    mainPen.setWidthF(hgt / 2);
+    const qreal mark_w = marker.size() * xUnit;
+    const qreal mark_h = marker.size() * yUnit;
+
+    zeroPointPen.setWidthF(mark_h / 2);
+    mainPen.setWidthF(mark_h / 2);
+
+    updateIndex();
+
+    const bool dense = framePrepared ? frameDense : useDensity();
+
+    if (dense)
+        paintDensity(painter);
 
     //рисуем точки стояния БМ
     painter->setBrush(zeroPointBr);
     painter->setPen(zeroPointPen);
     if (!points.isEmpty())
-        painter->drawRect(QRectF(points.at(0).x() - wdt / 2, points.at(0).y() - hgt / 2, wdt, hgt));
+        painter->drawRect(QRectF(points.at(0).x() - mark_w / 2, points.at(0).y() - mark_h / 2, mark_w, mark_h));
 
-    painter->setBrush(mainBrush);
-    painter->setPen(mainPen);
-    for (int i = 1; i < points.size(); ++i)
-        painter->drawRect(QRectF(points.at(i).x() - wdt / 2, points.at(i).y() - hgt / 2, wdt, hgt));
+    if (dense)
+        return;
+
+    if (index.isEmpty() || clip.isEmpty())
+    {
+        marker.paint(painter, points, NULL, 1, mainPen, mainBrush);
+        return;
+    }
+
+    //обходим только точки покрываемой области (с запасом на размер маркера)
+    index.query(points, clip.adjusted(-mark_w, -mark_h, mark_w, mark_h), visible);
+    marker.paint(painter, points, &visible, 1, mainPen, mainBrush);
+}
+
+void ChartPointData::prepareFrame(const QTransform& tr, qreal ratio)
+{
+    updateIndex();
+
+    frameDense = useDensity();
+    framePrepared = true;
+
+    //счетчики плотности всего вида: у полос кадра общая шкала цвета
+    if (frameDense)
+        density.prepare(tr, ratio, points, densityIndexes(view), 1, view);
+}
+
+bool ChartPointData::useDensity() const
+{
+    if (paintMode != AutoMode)
+        return paintMode == DensityMode;
+
+    //решение принимается по всему виду, а не по полосе кадра
+    if (view.isEmpty() || xUnit <= 0 || yUnit <= 0)
+        return false;
+
+    const qreal pixels = (view.width() / xUnit) * (view.height() / yUnit);
+    const int count = index.isEmpty() ? points.size() : index.count(points, view);
+
+    return count > densityThreshold * pixels;
+}
+
+const QVector<int>* ChartPointData::densityIndexes(const QRectF& area)
+{
+    //при малой видимой части набора обходим только ее ячейки индекса
+    const qreal covered = (area.width() * area.height()) / ((bounds.maxX - bounds.minX) * (bounds.maxY - bounds.minY));
+
+    if (index.isEmpty() || !(covered < 0.5))
+        return NULL;
+
+    index.query(points, area, visible);
+
+    return &visible;
+}
+
+void ChartPointData::paintDensity(QPainter* painter)
+{
+    density.setColor(mainBrush.color());
+
+    //счетчики подготовленного кадра уже накоплены
+    const QVector<int>* indexes = framePrepared ? NULL : densityIndexes(clip);
+    density.paint(painter, points, indexes, 1, clip);
+}
+
+void ChartPointData::setPoints(QVector<QPointF> pts)
+{
+    points.setData(std::move(pts));
+    updatePoints();
+}
+
+void ChartPointData::updatePoints(const ChartDataHints& hints)
+{
+    if (hints.hasBounds && points.capacity() == 0)
+        bounds = hints.bounds;
+    else
+        calcBounds(bounds, points);
+
+    //индекс строится при первом обращении: подключение файла не должно
+    //просматривать все его страницы
+    indexDirty = true;
+    dataChanged();
+}
+
+void ChartPointData::updateIndex() const
+{
+    //фоновый индекс принимается, только если данные с начала построения не менялись
+    if (indexPending && indexBuild.isFinished())
+    {
+        if (!indexDirty)
+            index = indexBuild.result();
+
+        indexBuild = QFuture<ChartGridIndex>();
+        indexPending = false;
+    }
+
+    //пока строится фоновый индекс, точки перебираются полностью
+    if (!indexDirty || indexPending)
+        return;
+
+    index.clear();
+    indexDirty = false;
+
+    //на малых наборах полный перебор дешевле построения сетки
+    if (points.size() < indexThreshold)
+        return;
+
+    if (points.size() < backgroundIndexThreshold)
+    {
+        index.build(points, bounds);
+        return;
+    }
+
+    //копия серии разделяет буферы (или отображение файла) с элементом
+    indexBuild = QtConcurrent::run(&ChartPointData::buildIndex, points, bounds);
+    indexPending = true;
+}
+
+ChartGridIndex ChartPointData::buildIndex(ChartSeries series, ChartBounds area)
+{
+    ChartGridIndex result;
+    result.build(series, area);
+
+    return result;
 }
 
-void ChartPointData::setPoints(const QVector<QPointF>& pts)
+void ChartPointData::appendPoints(const QPointF* data, int count)
 {
-    points = pts;
+    if (count <= 0)
+        return;
+
+    points.append(data, count);
+    appendBounds(bounds, points, count);
+    indexDirty = true;
+    dataChanged();
 }
 
 void ChartPointData::setData(const QVector<QPointF>& points)
@@ -359,12 +1205,103 @@ void ChartPointData::setData(const QVector<QPointF>& points)
         return;
 
     setPoints(points);
-    calcBounds(bounds, points);
+}
+
+void ChartPointData::setData(QVector<QPointF>&& points)
+{
+    if (points.size() == 0)
+        return;
+
+    setPoints(std::move(points));
+}
+
+void ChartPointData::setExternalData(const qreal* x_data, const qreal* y_data, int count, int stride,
+                                     const std::shared_ptr<const void>& keep_alive,
+                                     const ChartDataHints& hints)
+{
+    if (count <= 0)
+        return;
+
+    points.setExternal(x_data, y_data, count, stride, keep_alive);
+    updatePoints(hints);
+}
+
+void ChartPointData::appendData(const QVector<QPointF>& points)
+{
+    appendPoints(points.constData(), points.size());
+}
+
+void ChartPointData::appendPoint(const QPointF& point)
+{
+    appendPoints(&point, 1);
+}
+
+void ChartPointData::setCapacity(int newCapacity)
+{
+    points.setCapacity(newCapacity);
+
+    if (newCapacity > 0 && !points.isEmpty())
+        bounds = points.windowBounds();
+
+    indexDirty = true;
+    dataChanged();
+}
+
+void ChartPointData::setColumnStorage(bool enabled)
+{
+    points.setLayout(enabled ? ChartSeries::Columnar : ChartSeries::Interleaved);
+}
+
+int ChartPointData::countInRect(const QRectF& rect) const
+{
+    updateIndex();
+
+    if (index.isEmpty())
+        return ::countInRect(points.xData(), points.yData(), points.size(), points.stride(), rect.normalized());
+
+    return index.count(points, rect.normalized());
+}
+
+QVector<QPointF> ChartPointData::pointsInRect(const QRectF& rect) const
+{
+    QVector<QPointF> result;
+
+    updateIndex();
+
+    if (index.isEmpty())
+    {
+        const QRectF area = rect.normalized();
+
+        //границы включаются, как и в индексе (QRectF::contains не принимает
+        //прямоугольник нулевой ширины)
+        for (int i = 0; i < points.size(); ++i)
+        {
+            const qreal x = points.x(i), y = points.y(i);
+
+            if (x >= area.left() && x <= area.right() && y >= area.top() && y <= area.bottom())
+                result.append(points.at(i));
+        }
+
+        return result;
+    }
+
+    QVector<int> found;
+    index.query(points, rect.normalized(), found);
+
+    result.reserve(found.size());
+    for (int k = 0; k < found.size(); ++k)
+        result.append(points.at(found.at(k)));
+
+    return result;
 }
 
 void ChartPointData::clearData()
 {
     points.clear();
-    bounds.clear();
-    bounds.resize(4);
+    index.clear();
+    indexDirty = false;
+    indexBuild = QFuture<ChartGridIndex>();
+    indexPending = false;
+    bounds = ChartBounds();
+    dataChanged();
 }
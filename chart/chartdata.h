@@ -2,41 +2,122 @@
 #define CHARTDATA_H
 
 #include "chartlayeritem.h"
+#include "chartseries.h"
+#include "chartindex.h"
+#include "chartmarker.h"
+#include "chartdensity.h"
+#include "chartpyramid.h"
+
+#include <QFuture>
 
 class PlainChart;
+class ChartData;
 class ChartAxis;
 class ChartText;
 class ChartRouteData;
+class ChartRenderer;
 
 
 enum DataType { polygs, trajects, routes, points };
 
 
+//заранее известные свойства внешних данных (например, из заголовка файла),
+//позволяют не просматривать все точки при подключении
+struct ChartDataHints
+{
+    ChartDataHints() : hasBounds(false), sortedByX(false) { }
+
+    bool hasBounds;
+    ChartBounds bounds;
+    //true - точки упорядочены по x, false - неизвестно
+    bool sortedByX;
+};
+
+
+//снимок параметров осей, по которому рисуются данные
+struct ChartProjection
+{
+    qreal xOffset, yOffset;
+    qreal xShift, yShift;
+    qreal xSpan, ySpan;
+    qreal xScale, yScale;
+    int xPixels, yPixels;
+    bool xInverted, yInverted;
+    QRectF window;
+
+    bool operator==(const ChartProjection& other) const
+    {
+        return xOffset == other.xOffset && yOffset == other.yOffset
+            && xShift == other.xShift && yShift == other.yShift
+            && xSpan == other.xSpan && ySpan == other.ySpan
+            && xPixels == other.xPixels && yPixels == other.yPixels
+            && xInverted == other.xInverted && yInverted == other.yInverted
+            && window == other.window;
+    }
+    bool operator!=(const ChartProjection& other) const { return !(*this == other); }
+};
+
+
 class ChartDataItem
 {
 public:
-    ChartDataItem() { bounds.resize(4); }
+    ChartDataItem() : xUnit(0), yUnit(0), yShift(0), owner(NULL) { }
     virtual ~ChartDataItem() {}
 
     virtual void paint(QPainter* painter) = 0;
+    //независимая копия элемента для отрисовки в другом потоке
+    virtual ChartDataItem* clone() const = 0;
+    //досчитывает отложенные структуры до копирования, чтобы копии их разделяли
+    virtual void prepare() { }
+    //общие для всех полос кадра расчеты по всей видимой области: вызывается после задания
+    //вида до копирования элемента по полосам (tr - перевод данных в пиксели кадра)
+    virtual void prepareFrame(const QTransform& tr, qreal ratio) { Q_UNUSED(tr); Q_UNUSED(ratio); }
     virtual void setData(const QVector<QPointF>& data) = 0;
-    virtual void setPen(const QPen& pen) { mainPen = pen; }
-    virtual void setBrush(const QBrush& br) { mainBrush = br; }
-    virtual void setColor(Qt::GlobalColor color) { mainPen.setColor(color); mainBrush.setColor(color); }
+    virtual void setData(QVector<QPointF>&& data) { setData(static_cast<const QVector<QPointF>&>(data)); }
+    //точки берутся из x_data[i * stride], y_data[i * stride] без копирования;
+    //keep_alive удерживает владельца буфера, пока элемент на него ссылается
+    virtual void setExternalData(const qreal* x_data, const qreal* y_data, int count, int stride = 1,
+                                 const std::shared_ptr<const void>& keep_alive = std::shared_ptr<const void>(),
+                                 const ChartDataHints& hints = ChartDataHints());
+    virtual void appendData(const QVector<QPointF>& data) { Q_UNUSED(data); }
+    virtual void appendPoint(const QPointF& point) { Q_UNUSED(point); }
+    virtual void setCapacity(int newCapacity) { Q_UNUSED(newCapacity); }
+    virtual void setColumnStorage(bool enabled) { Q_UNUSED(enabled); }
+    virtual void setPen(const QPen& pen) { mainPen = pen; styleChanged(); }
+    virtual void setBrush(const QBrush& br) { mainBrush = br; styleChanged(); }
+    virtual void setColor(Qt::GlobalColor color) { mainPen.setColor(color); mainBrush.setColor(color); styleChanged(); }
     virtual void setParams(qreal new_w, qreal new_h) { wdt = new_w; hgt = new_h; }
+    virtual void setViewport(const QRectF& window, qreal x_unit, qreal y_unit) { view = clip = window; xUnit = x_unit; yUnit = y_unit; }
+    void setClip(const QRectF& rect) { clip = rect; }
     virtual void clearData() = 0;
     virtual bool isEmpty() const = 0;
-    virtual const QVector<qreal> range() const { return bounds; }
+    virtual const ChartBounds& range() const { return bounds; }
 
     QPen pen() const { return mainPen; }
     QBrush brush() const { return mainBrush; }
 
 protected:
+    void dataChanged();
+    void styleChanged();
+    //область отсечения линий пера pen: штриховка отсчитывается от начала линии, поэтому
+    //прерывистые линии отсекаются по всему виду и у полос кадра отличаются только сдвигом
+    const QRectF& strokeClip(const QPen& pen) const
+    { return (pen.style() == Qt::SolidLine || pen.style() == Qt::NoPen) ? clip : view; }
+
     qreal hgt;
     qreal wdt;
-    QVector<qreal> bounds;
+    QRectF view;        //видимая область в координатах данных
+    QRectF clip;        //часть view, покрываемая устройством (тайлом)
+    qreal xUnit, yUnit; //единиц данных на пиксель
+    qreal yShift;       //сдвиг оси y проекции (верх прежнего логического окна)
+    ChartBounds bounds;
     QPen mainPen;
     QBrush mainBrush;
+
+private:
+    ChartData* owner;
+
+    friend class ChartData;
 };
 
 
@@ -56,18 +137,34 @@ public:
 
     void clearData();
     bool isEmpty() const;
-    const QVector<qreal> range() const;
+    const ChartBounds& range() const;
+
+    ChartProjection projection() const;
+    QVector<ChartDataItem*> cloneItems() const;
+
+    static void initPainter(QPainter* painter, const ChartProjection& proj);
+    //отображение координат данных в пиксели виджета, заданное initPainter
+    static QTransform pixelTransform(const ChartProjection& proj);
+    static void paintItem(QPainter* painter, ChartDataItem* item, const ChartProjection& proj,
+                          const QRectF& clip = QRectF());
+    static void prepareItem(ChartDataItem* item, const ChartProjection& proj, qreal ratio);
 
 private:
-    void initPainter(QPainter* painter);
+    static void applyProjection(ChartDataItem* item, const ChartProjection& proj);
+    void invalidateRange();
+    void invalidateLayer();
 
     PlainChart* chart;
     ChartRouteData* hghtItem;
     QVector<ChartDataItem*> mData;
+    mutable ChartBounds cachedRange;
+    mutable bool rangeDirty;
 
+    friend class ChartDataItem;
     friend class PlainChart;
     friend class ChartText;
     friend class ChartAxis;
+    friend class ChartRenderer;
 };
 
 
@@ -78,15 +175,36 @@ public:
     virtual ~ChartPolygonData() { clearData(); }
 
     virtual void paint(QPainter* painter);
+    virtual ChartDataItem* clone() const { return new ChartPolygonData(*this); }
     virtual void setData(const QVector<QPointF>& pols);
+    virtual void setData(QVector<QPointF>&& pols);
     virtual void clearData();
-    virtual bool isEmpty() const { return polygs.isEmpty(); }
+    virtual bool isEmpty() const { return shapes.isEmpty(); }
 
-private:
-    void setPolys(const QPolygonF& pols);
+    //добавляет контур к уже заданным; без стиля контур рисуется основными пером и кистью
+    void addPolygon(const QVector<QPointF>& polygon);
+    void addPolygon(const QVector<QPointF>& polygon, const QPen& pen, const QBrush& brush);
+
+    int polygonCount() const { return shapes.size(); }
 
-    QPolygonF polygs;
+private:
+    //контур и его упрощения с растущим допуском (в единицах данных)
+    struct Shape
+    {
+        QVector<QPolygonF> levels;
+        QVector<qreal> tolerances;
+        ChartBounds bounds;
+        bool styled;
+    };
+
+    void setPolys(QPolygonF pols);
+    void appendShape(QPolygonF polygon);
+    void updatePolys();
+    int levelFor(const Shape& shape, qreal tolerance) const;
+
+    QVector<Shape> shapes;
     QVector<QPair<QPen, QBrush> > stylePairs;
+    QPolygonF clipped, clipBuffer;
 };
 
 
@@ -97,16 +215,52 @@ public:
     virtual ~ChartTrajectoryData() { clearData(); }
 
     virtual void paint(QPainter* painter);
+    virtual ChartDataItem* clone() const { return new ChartTrajectoryData(*this); }
     virtual void setData(const QVector<QPointF>& data);
+    virtual void setData(QVector<QPointF>&& data);
+    virtual void setExternalData(const qreal* x_data, const qreal* y_data, int count, int stride = 1,
+                                 const std::shared_ptr<const void>& keep_alive = std::shared_ptr<const void>(),
+                                 const ChartDataHints& hints = ChartDataHints());
+    virtual void appendData(const QVector<QPointF>& data);
+    virtual void appendPoint(const QPointF& point);
+    virtual void setCapacity(int newCapacity);
+    virtual void setColumnStorage(bool enabled);
     virtual void clearData();
     virtual bool isEmpty() const { return traj.isEmpty(); }
 
     void setColor(Qt::GlobalColor trajectoryColor);
+    void setLodThreshold(qreal ratio) { lodRatio = ratio; styleChanged(); }
 
-private:
-    void setTraj(const QVector<QPointF>& newTraj);
+    qreal lodThreshold() const { return lodRatio; }
+    //память, занятая готовой пирамидой прореживания, байт
+    qint64 pyramidMemory() const { return pyramid ? pyramid->memoryUsage() : 0; }
 
-    QVector<QPointF> traj;
+private:
+    void setTraj(QVector<QPointF> newTraj);
+    void updateTraj(const ChartDataHints& hints = ChartDataHints());
+    void appendTraj(const QPointF* data, int count);
+    bool paintDecimated(QPainter* painter);
+    void clipRange(qreal left, qreal right, int& first, int& last) const;
+
+    void startPyramid();
+    void resetPyramid();
+    void updatePyramid();
+    const ChartPyramid* readyPyramid();
+    static std::shared_ptr<ChartPyramid> buildPyramid(ChartSeries series, std::weak_ptr<const void> token);
+
+    ChartSeries traj;
+    QPolygonF lodTraj;
+    qreal lodRatio;
+    bool xSorted;
+
+    //пирамида строится в фоне для больших упорядоченных траекторий;
+    //копии элемента разделяют ее до первой дозаписи
+    std::shared_ptr<ChartPyramid> pyramid;
+    QFuture<std::shared_ptr<ChartPyramid> > pyramidBuild;
+    std::shared_ptr<const void> pyramidToken;
+    bool pyramidPending;
+    QPolygonF lodPoints;
+    ChartSeries lodSeries;
 };
 
 
@@ -117,39 +271,108 @@ public:
     virtual ~ChartRouteData() { clearData(); }
 
     virtual void paint(QPainter* painter);
+    virtual ChartDataItem* clone() const { return new ChartRouteData(*this); }
     virtual void setData(const QVector<QPointF>& prof);
+    virtual void setData(QVector<QPointF>&& prof);
+    virtual void setExternalData(const qreal* x_data, const qreal* y_data, int count, int stride = 1,
+                                 const std::shared_ptr<const void>& keep_alive = std::shared_ptr<const void>(),
+                                 const ChartDataHints& hints = ChartDataHints());
+    virtual void appendData(const QVector<QPointF>& prof);
+    virtual void appendPoint(const QPointF& point);
+    virtual void setCapacity(int newCapacity);
+    virtual void setColumnStorage(bool enabled);
     virtual void clearData();
     virtual bool isEmpty() const { return profile.isEmpty(); }
 
     qreal heightValue(qreal x_value) const;
+    void setInterpolation(bool enabled) { interpolate = enabled; }
 
-private:
-    void setRoute(const QVector<QPointF>& prof);
+    bool isInterpolated() const { return interpolate; }
 
-    QVector<QPointF> profile;
+private:
+    void setRoute(QVector<QPointF> prof);
+    void updateRoute(const ChartDataHints& hints = ChartDataHints());
+    void appendRoute(const QPointF* data, int count);
+    bool segmentContains(int index, qreal x_value) const;
+    int segmentAt(qreal x_value) const;
+    void updateFill(qreal lower);
+
+    ChartSeries profile;
+    mutable int lastSegment;
+    bool interpolate;
+    bool xSorted;
+
+    //замкнутый контур заливки, перестраивается при изменении данных или окна
+    QPolygonF fill;
+    QPolygonF lodFill;
+    qreal fillLower, fillLeft, fillRight, fillUnit;
+    bool fillDirty;
 };
 
 
 class ChartPointData : public ChartDataItem
 {
 public:
+    //по умолчанию - маркеры; AutoMode переключается на плотность,
+    //когда точек на пиксель больше порога
+    enum PaintMode { MarkerMode, DensityMode, AutoMode };
+
     ChartPointData();
     virtual ~ChartPointData() { clearData(); }
 
     virtual void paint(QPainter* painter);
+    virtual ChartDataItem* clone() const { return new ChartPointData(*this); }
+    virtual void prepare() { updateIndex(); }
+    virtual void prepareFrame(const QTransform& tr, qreal ratio);
     virtual void setData(const QVector<QPointF>& points);
+    virtual void setData(QVector<QPointF>&& points);
+    virtual void setExternalData(const qreal* x_data, const qreal* y_data, int count, int stride = 1,
+                                 const std::shared_ptr<const void>& keep_alive = std::shared_ptr<const void>(),
+                                 const ChartDataHints& hints = ChartDataHints());
+    virtual void appendData(const QVector<QPointF>& points);
+    virtual void appendPoint(const QPointF& point);
+    virtual void setCapacity(int newCapacity);
+    virtual void setColumnStorage(bool enabled);
     virtual void clearData();
     virtual bool isEmpty() const { return points.isEmpty(); }
 
-    void setZeroPointBrush(QBrush newBrush) { zeroPointBr = newBrush; }
-    void setZeroPointPen(QPen newPen) { zeroPointPen = newPen; }
+    void setZeroPointBrush(QBrush newBrush) { zeroPointBr = newBrush; styleChanged(); }
+    void setZeroPointPen(QPen newPen) { zeroPointPen = newPen; styleChanged(); }
+    void setMarkerSize(qreal pixels) { marker.setSize(pixels); styleChanged(); }
+    void setPaintMode(PaintMode mode) { paintMode = mode; styleChanged(); }
+    void setDensityThreshold(qreal points_per_pixel) { densityThreshold = points_per_pixel; styleChanged(); }
+    void setColorMap(const QVector<QRgb>& colors) { density.setColorMap(colors); styleChanged(); }
 
     QPen zeroPen() const { return zeroPointPen; }
+    qreal markerSize() const { return marker.size(); }
+    PaintMode mode() const { return paintMode; }
+    qreal densityLimit() const { return densityThreshold; }
+    int countInRect(const QRectF& rect) const;
+    QVector<QPointF> pointsInRect(const QRectF& rect) const;
 
 private:
-    void setPoints(const QVector<QPointF>& pts);
-
-    QVector<QPointF> points;
+    void setPoints(QVector<QPointF> pts);
+    void updatePoints(const ChartDataHints& hints = ChartDataHints());
+    void appendPoints(const QPointF* data, int count);
+    void updateIndex() const;
+    static ChartGridIndex buildIndex(ChartSeries series, ChartBounds area);
+    bool useDensity() const;
+    const QVector<int>* densityIndexes(const QRectF& area);
+    void paintDensity(QPainter* painter);
+
+    ChartSeries points;
+    mutable ChartGridIndex index;
+    mutable bool indexDirty;
+    //большие наборы индексируются в фоне
+    mutable QFuture<ChartGridIndex> indexBuild;
+    mutable bool indexPending;
+    QVector<int> visible;
+    ChartMarker marker;
+    ChartDensity density;
+    PaintMode paintMode;
+    qreal densityThreshold;
+    //решение о плотности, принятое для всего кадра в prepareFrame
+    bool framePrepared, frameDense;
     QPen zeroPointPen;
     QBrush zeroPointBr;
 };
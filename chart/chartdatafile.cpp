@@ -0,0 +1,307 @@
+#include "chartdatafile.h"
+#include "chartkernels.h"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+
+static const char fileMagic[8] = { 'C', 'H', 'A', 'R', 'T', 'P', 'T', 'S' };
+static const quint32 fileVersion = 1;
+
+enum FileFlags { ColumnarFlag = 0x1, FloatFlag = 0x2, SortedFlag = 0x4 };
+
+//заголовок в том виде, как он лежит в файле
+struct FileHeader
+{
+    char magic[8];
+    quint32 version;
+    quint32 flags;
+    quint64 count;
+    quint64 offset;
+    double bounds[4];
+};
+
+static_assert(sizeof(FileHeader) == 64, "unexpected header layout");
+
+static inline void setError(QString* error, const QString& text)
+{
+    if (error != NULL)
+        *error = text;
+}
+
+
+ChartDataFile::ChartDataFile()
+    : mapped(NULL),
+    xp(NULL), yp(NULL),
+    st(1), cnt(0),
+    lay(Interleaved), prec(Double)
+{
+}
+
+ChartDataFile::~ChartDataFile()
+{
+    if (mapped != NULL)
+        file.unmap(mapped);
+}
+
+std::shared_ptr<ChartDataFile> ChartDataFile::open(const QString& path, QString* error)
+{
+    std::shared_ptr<ChartDataFile> result(new ChartDataFile());
+
+    if (!result->load(path, error))
+        return std::shared_ptr<ChartDataFile>();
+
+    return result;
+}
+
+bool ChartDataFile::load(const QString& path, QString* error)
+{
+#if Q_BYTE_ORDER != Q_LITTLE_ENDIAN
+    Q_UNUSED(path);
+    setError(error, QStringLiteral("big-endian hosts are not supported"));
+    return false;
+#else
+    file.setFileName(path);
+
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        setError(error, file.errorString());
+        return false;
+    }
+
+    const qint64 file_size = file.size();
+
+    if (file_size < (qint64)sizeof(FileHeader))
+    {
+        setError(error, QStringLiteral("file is too short"));
+        return false;
+    }
+
+    mapped = file.map(0, file_size);
+
+    if (mapped == NULL)
+    {
+        setError(error, file.errorString());
+        return false;
+    }
+
+    Header header;
+
+    if (!readHeader(mapped, file_size, header, error))
+        return false;
+
+    cnt = header.count;
+    lay = header.layout;
+    prec = header.precision;
+    hnt = header.hints;
+
+    const uchar* data = mapped + header.offset;
+    const int stride = (lay == Interleaved) ? 2 : 1;
+    const int y_shift = (lay == Interleaved) ? 1 : cnt;
+
+    //значения передаются без копирования, только если они уже в формате qreal
+    //(qreal бывает float, например при QT_COORD_TYPE)
+    if (prec == Float || sizeof(qreal) != sizeof(double))
+    {
+        bool ok;
+
+        if (prec == Float)
+        {
+            const float* values = reinterpret_cast<const float*>(data);
+            ok = widen(values, values + y_shift, stride, error);
+        }
+        else
+        {
+            const double* values = reinterpret_cast<const double*>(data);
+            ok = widen(values, values + y_shift, stride, error);
+        }
+
+        //отображение больше не нужно
+        file.unmap(mapped);
+        mapped = NULL;
+        file.close();
+        return ok;
+    }
+
+    xp = reinterpret_cast<const qreal*>(data);
+    yp = xp + y_shift;
+    st = stride;
+
+    return true;
+#endif
+}
+
+int ChartDataFile::headerSize()
+{
+    return sizeof(FileHeader);
+}
+
+bool ChartDataFile::readHeader(const uchar* data, qint64 file_size, Header& header, QString* error)
+{
+    if (file_size < (qint64)sizeof(FileHeader))
+    {
+        setError(error, QStringLiteral("file is too short"));
+        return false;
+    }
+
+    FileHeader raw;
+    memcpy(&raw, data, sizeof(raw));
+
+    if (memcmp(raw.magic, fileMagic, sizeof(fileMagic)) != 0 || raw.version != fileVersion)
+    {
+        setError(error, QStringLiteral("unknown file format"));
+        return false;
+    }
+
+    const quint64 element = (raw.flags & FloatFlag) ? sizeof(float) : sizeof(double);
+
+    if (raw.count > (quint64)std::numeric_limits<int>::max() ||
+        raw.offset < sizeof(FileHeader) || raw.offset % 8 != 0 ||
+        raw.offset > (quint64)file_size || ((quint64)file_size - raw.offset) / (2 * element) < raw.count)
+    {
+        setError(error, QStringLiteral("corrupted header"));
+        return false;
+    }
+
+    header.count = raw.count;
+    header.layout = (raw.flags & ColumnarFlag) ? Columnar : Interleaved;
+    header.precision = (raw.flags & FloatFlag) ? Float : Double;
+    header.offset = raw.offset;
+
+    header.hints.sortedByX = (raw.flags & SortedFlag) != 0;
+    header.hints.hasBounds = !std::isnan(raw.bounds[0]) && !std::isnan(raw.bounds[1]) &&
+                             !std::isnan(raw.bounds[2]) && !std::isnan(raw.bounds[3]);
+    header.hints.bounds = ChartBounds(raw.bounds[0], raw.bounds[1], raw.bounds[2], raw.bounds[3]);
+
+    return true;
+}
+
+template <class T>
+bool ChartDataFile::widen(const T* x_data, const T* y_data, int stride, QString* error)
+{
+    //ChartSeries читает только qreal, поэтому значения копируются в пары (x, y).
+    //Размер QVector ограничен int и 2 ГБ, больший файл читается только как double
+    const qint64 size = (qint64)cnt * 2;
+
+    if (size * (qint64)sizeof(qreal) > std::numeric_limits<int>::max())
+    {
+        setError(error, QStringLiteral("too many points to convert to qreal"));
+        return false;
+    }
+
+    widened.resize(size);
+    qreal* out = widened.data();
+
+    for (int i = 0; i < cnt; ++i)
+    {
+        out[2 * i] = x_data[(qint64)i * stride];
+        out[2 * i + 1] = y_data[(qint64)i * stride];
+    }
+
+    xp = out;
+    yp = out + 1;
+    st = 2;
+
+    return true;
+}
+
+void ChartDataFile::attach(ChartDataItem* item) const
+{
+    //пустой файл - пустой элемент
+    if (cnt == 0)
+    {
+        item->clearData();
+        return;
+    }
+
+    item->setExternalData(xp, yp, cnt, st, shared_from_this(), hnt);
+}
+
+bool ChartDataFile::save(const QString& path, const QVector<QPointF>& points,
+                         Layout layout, Precision precision, QString* error)
+{
+#if Q_BYTE_ORDER != Q_LITTLE_ENDIAN
+    Q_UNUSED(path); Q_UNUSED(points); Q_UNUSED(layout); Q_UNUSED(precision);
+    setError(error, QStringLiteral("big-endian hosts are not supported"));
+    return false;
+#else
+    const int count = points.size();
+    const qreal nan = std::numeric_limits<double>::quiet_NaN();
+    //у пустого набора габаритов нет
+    ChartBounds bounds = (count > 0) ? boundsOfPoints(points.constData(), count)
+                                     : ChartBounds(nan, nan, nan, nan);
+
+    //габариты должны охватывать значения, как они записаны: округление до float
+    //может вывести крайние точки за габариты double
+    if (precision == Float)
+        bounds = ChartBounds((float)bounds.minX, (float)bounds.maxX, (float)bounds.minY, (float)bounds.maxY);
+
+    bool sorted = true;
+    for (int i = 1; i < count && sorted; ++i)
+        sorted = points.at(i - 1).x() <= points.at(i).x();
+
+    FileHeader header;
+    memcpy(header.magic, fileMagic, sizeof(fileMagic));
+    header.version = fileVersion;
+    header.flags = (layout == Columnar ? ColumnarFlag : 0) | (precision == Float ? FloatFlag : 0) |
+                   (sorted ? SortedFlag : 0);
+    header.count = count;
+    header.offset = sizeof(FileHeader);
+    header.bounds[0] = bounds.minX;
+    header.bounds[1] = bounds.maxX;
+    header.bounds[2] = bounds.minY;
+    header.bounds[3] = bounds.maxY;
+
+    QFile out(path);
+
+    if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        setError(error, out.errorString());
+        return false;
+    }
+
+    bool ok = out.write(reinterpret_cast<const char*>(&header), sizeof(header)) == sizeof(header);
+
+    //значения пишутся блоками: x и y парами или двумя столбцами
+    static const int block = 4096;
+    const int passes = (layout == Columnar) ? 2 : 1;
+    QVector<double> doubles(2 * block);
+    QVector<float> floats(2 * block);
+
+    for (int pass = 0; pass < passes && ok; ++pass)
+        for (int start = 0; start < count && ok; start += block)
+        {
+            const int size = qMin(block, count - start);
+            int n = 0;
+
+            for (int i = start; i < start + size; ++i)
+            {
+                const QPointF& point = points.at(i);
+
+                if (layout == Interleaved)
+                {
+                    doubles[n++] = point.x();
+                    doubles[n++] = point.y();
+                }
+                else
+                    doubles[n++] = (pass == 0) ? point.x() : point.y();
+            }
+
+            if (precision == Float)
+            {
+                for (int i = 0; i < n; ++i)
+                    floats[i] = doubles[i];
+
+                ok = out.write(reinterpret_cast<const char*>(floats.constData()), n * sizeof(float)) == qint64(n * sizeof(float));
+            }
+            else
+                ok = out.write(reinterpret_cast<const char*>(doubles.constData()), n * sizeof(double)) == qint64(n * sizeof(double));
+        }
+
+    if (!ok)
+        setError(error, out.errorString());
+
+    return ok;
+#endif
+}
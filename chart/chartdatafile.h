@@ -0,0 +1,87 @@
+#ifndef CHARTDATAFILE_H
+#define CHARTDATAFILE_H
+
+#include "chartdata.h"
+
+#include <QFile>
+#include <QString>
+#include <QVector>
+
+#include <memory>
+
+//файл точек, отображаемый в память. Формат (little-endian):
+//
+//  смещение  размер  поле
+//   0        8       сигнатура "CHARTPTS"
+//   8        4       версия, 1
+//  12        4       флаги: 0x1 - столбцы (x[n], затем y[n]), иначе пары (x, y);
+//                    0x2 - float, иначе double; 0x4 - точки упорядочены по x
+//  16        8       число точек n
+//  24        8       смещение данных от начала файла, кратно 8 и не меньше 64
+//  32        32      габариты: minX, maxX, minY, maxY (double); NaN - неизвестны
+//
+//Точки double передаются элементу прямо из отображения, страницы подгружаются
+//системой по мере чтения. Точки float (и double, если qreal - float) приводятся
+//к qreal в память при открытии. Файл может быть пустым (n = 0)
+class ChartDataFile : public std::enable_shared_from_this<ChartDataFile>
+{
+public:
+    enum Layout { Interleaved, Columnar };
+    enum Precision { Double, Float };
+
+    //содержимое файла по заголовку
+    struct Header
+    {
+        int count;
+        Layout layout;
+        Precision precision;
+        qint64 offset;
+        ChartDataHints hints;
+    };
+
+    ~ChartDataFile();
+
+    //размер заголовка, байт
+    static int headerSize();
+    //разбор и проверка заголовка; file_size - полный размер файла
+    static bool readHeader(const uchar* data, qint64 file_size, Header& header, QString* error = NULL);
+
+    //NULL при ошибке, причина - в error
+    static std::shared_ptr<ChartDataFile> open(const QString& path, QString* error = NULL);
+    static bool save(const QString& path, const QVector<QPointF>& points,
+                     Layout layout = Interleaved, Precision precision = Double, QString* error = NULL);
+
+    int count() const { return cnt; }
+    Layout layout() const { return lay; }
+    Precision precision() const { return prec; }
+    const ChartDataHints& hints() const { return hnt; }
+
+    const qreal* xData() const { return xp; }
+    const qreal* yData() const { return yp; }
+    int stride() const { return st; }
+
+    //передает точки элементу без копирования; файл остается открытым,
+    //пока на него ссылается элемент; пустой файл очищает элемент
+    void attach(ChartDataItem* item) const;
+
+private:
+    ChartDataFile();
+
+    bool load(const QString& path, QString* error);
+    template <class T>
+    bool widen(const T* x_data, const T* y_data, int stride, QString* error);
+
+    QFile file;
+    uchar* mapped;
+    QVector<qreal> widened;
+
+    const qreal* xp;
+    const qreal* yp;
+    int st;
+    int cnt;
+    Layout lay;
+    Precision prec;
+    ChartDataHints hnt;
+};
+
+#endif // CHARTDATAFILE_H
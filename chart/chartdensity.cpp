@@ -0,0 +1,318 @@
+#include "chartdensity.h"
+#include "chartkernels.h"
+
+#include <QtConcurrent>
+#include <QThreadPool>
+#include <QtMath>
+
+#include <algorithm>
+
+
+//точек на один поток при параллельном накоплении
+static const int chunkPoints = 256 * 1024;
+//предел памяти под частичные буферы счетчиков
+static const qint64 maxPartialBytes = 64 * 1024 * 1024;
+static const int tableSize = 256;
+
+
+ChartDensity::ChartDensity()
+    : mainColor(Qt::red),
+    tableDirty(true),
+    frameRatio(1),
+    frameMax(0),
+    framePrepared(false)
+{
+}
+
+void ChartDensity::setColorMap(const QVector<QRgb>& colors)
+{
+    colorMap = colors;
+    tableDirty = true;
+}
+
+void ChartDensity::setColor(const QColor& color)
+{
+    if (color == mainColor)
+        return;
+
+    mainColor = color;
+    tableDirty = true;
+}
+
+void ChartDensity::paint(QPainter* painter, const ChartSeries& series, const QVector<int>* indexes, int first,
+                         const QRectF& clip)
+{
+    const QTransform tr = painter->combinedTransform();
+    const qreal ratio = painter->device()->devicePixelRatioF();
+
+    Grid grid;
+
+    if (!makeGrid(tr, ratio, clip, grid))
+        return;
+
+    int dx, dy;
+
+    if (framePrepared && frameShift(tr, ratio, dx, dy))
+    {
+        //пиксели полосы в координатах кадра
+        Grid part = grid;
+        part.left += dx;
+        part.top += dy;
+
+        colorize(part, frameCounts.constData(), frameGrid, frameMax);
+    }
+    else
+    {
+        accumulateGrid(series, indexes, first, grid);
+
+        const quint32* bins = counts.constData();
+        quint32 max_count = 0;
+
+        for (int i = 0; i < counts.size(); ++i)
+            max_count = qMax(max_count, bins[i]);
+
+        colorize(grid, bins, grid, max_count);
+    }
+
+    painter->save();
+    painter->resetTransform();
+    painter->setViewTransformEnabled(false);
+    image.setDevicePixelRatio(ratio);
+    painter->drawImage(QPointF(grid.left / ratio, grid.top / ratio), image);
+    painter->restore();
+}
+
+void ChartDensity::prepare(const QTransform& tr, qreal ratio, const ChartSeries& series, const QVector<int>* indexes,
+                           int first, const QRectF& clip)
+{
+    framePrepared = false;
+
+    if (!makeGrid(tr, ratio, clip, frameGrid))
+        return;
+
+    accumulateGrid(series, indexes, first, frameGrid);
+
+    //буфер отдается кадру целиком, следующий paint без кадра заведет свой
+    frameCounts = counts;
+    frameMax = 0;
+
+    for (int i = 0; i < frameCounts.size(); ++i)
+        frameMax = qMax(frameMax, frameCounts.at(i));
+
+    frameTransform = tr;
+    frameRatio = ratio;
+    framePrepared = true;
+}
+
+bool ChartDensity::makeGrid(const QTransform& tr, qreal ratio, const QRectF& clip, Grid& grid)
+{
+    if (tr.m11() == 0 || tr.m22() == 0)
+        return false;
+
+    //пиксели устройства, покрываемые clip
+    const QRectF area = tr.mapRect(clip);
+    grid.left = qFloor(area.left() * ratio);
+    grid.top = qFloor(area.top() * ratio);
+    grid.width = qCeil(area.right() * ratio) - grid.left;
+    grid.height = qCeil(area.bottom() * ratio) - grid.top;
+    grid.xUnit = 1 / (tr.m11() * ratio);
+    grid.yUnit = 1 / (tr.m22() * ratio);
+    grid.xOrigin = (grid.left / ratio - tr.dx()) / tr.m11();
+    grid.yOrigin = (grid.top / ratio - tr.dy()) / tr.m22();
+
+    return grid.width > 0 && grid.height > 0;
+}
+
+bool ChartDensity::frameShift(const QTransform& tr, qreal ratio, int& dx, int& dy) const
+{
+    //полоса кадра отличается от него только целым сдвигом в пикселях устройства
+    if (ratio != frameRatio || tr.m11() != frameTransform.m11() || tr.m22() != frameTransform.m22())
+        return false;
+
+    const qreal x_shift = (frameTransform.dx() - tr.dx()) * ratio;
+    const qreal y_shift = (frameTransform.dy() - tr.dy()) * ratio;
+    dx = qRound(x_shift);
+    dy = qRound(y_shift);
+
+    return qAbs(x_shift - dx) < 1e-6 && qAbs(y_shift - dy) < 1e-6;
+}
+
+void ChartDensity::accumulateGrid(const ChartSeries& series, const QVector<int>* indexes, int first, const Grid& grid)
+{
+    counts.fill(0, grid.width * grid.height);
+
+    if (indexes != NULL)
+        accumulateIndexes(series, *indexes, first, grid);
+    else
+        accumulateParallel(series, first, grid);
+}
+
+void ChartDensity::accumulate(const Chunk& chunk)
+{
+    static const int block = 1024;
+    qreal cols[block];
+    qreal rows[block];
+
+    const ChartSeries& series = *chunk.series;
+    const Grid& grid = *chunk.grid;
+    const int stride = series.stride();
+
+    for (int start = chunk.from; start < chunk.to; start += block)
+    {
+        const int count = qMin(block, chunk.to - start);
+
+        pixelColumns(series.xData() + start * stride, count, stride, grid.xOrigin, grid.xUnit, cols);
+        pixelColumns(series.yData() + start * stride, count, stride, grid.yOrigin, grid.yUnit, rows);
+
+        //NaN не проходит ни одно из сравнений
+        for (int k = 0; k < count; ++k)
+        {
+            if (cols[k] >= 0 && cols[k] < grid.width && rows[k] >= 0 && rows[k] < grid.height)
+                ++chunk.bins[int(rows[k]) * grid.width + int(cols[k])];
+        }
+    }
+}
+
+void ChartDensity::accumulateIndexes(const ChartSeries& series, const QVector<int>& indexes, int first, const Grid& grid)
+{
+    quint32* bins = counts.data();
+
+    for (int k = 0; k < indexes.size(); ++k)
+    {
+        const int i = indexes.at(k);
+
+        if (i < first)
+            continue;
+
+        const qreal col = qFloor((series.x(i) - grid.xOrigin) / grid.xUnit);
+        const qreal row = qFloor((series.y(i) - grid.yOrigin) / grid.yUnit);
+
+        if (col >= 0 && col < grid.width && row >= 0 && row < grid.height)
+            ++bins[int(row) * grid.width + int(col)];
+    }
+}
+
+void ChartDensity::accumulateParallel(const ChartSeries& series, int first, const Grid& grid)
+{
+    const int size = series.size() - first;
+
+    if (size <= 0)
+        return;
+
+    //число потоков ограничено и числом точек, и памятью под частичные буферы
+    const qint64 buffer_bytes = qint64(counts.size()) * sizeof(quint32);
+    const int by_memory = int(maxPartialBytes / qMax<qint64>(buffer_bytes, 1)) + 1;
+    const int threads = QThreadPool::globalInstance()->maxThreadCount();
+    const int parts = qMax(1, qMin(qMin(threads, size / chunkPoints), by_memory));
+
+    QVector<Chunk> chunks(parts);
+
+    if (partials.size() < parts - 1)
+        partials.resize(parts - 1);
+
+    for (int p = 0; p < parts; ++p)
+    {
+        Chunk& chunk = chunks[p];
+        chunk.series = &series;
+        chunk.grid = &grid;
+        chunk.from = first + qint64(size) * p / parts;
+        chunk.to = first + qint64(size) * (p + 1) / parts;
+
+        //первый поток пишет сразу в итоговый буфер
+        if (p == 0)
+            chunk.bins = counts.data();
+        else
+        {
+            partials[p - 1].fill(0, counts.size());
+            chunk.bins = partials[p - 1].data();
+        }
+    }
+
+    if (parts == 1)
+    {
+        accumulate(chunks.at(0));
+        return;
+    }
+
+    QtConcurrent::blockingMap(chunks, &ChartDensity::accumulate);
+
+    quint32* bins = counts.data();
+    const int count = counts.size();
+
+    for (int p = 0; p < parts - 1; ++p)
+    {
+        const quint32* part = partials.at(p).constData();
+
+        for (int i = 0; i < count; ++i)
+            bins[i] += part[i];
+    }
+}
+
+void ChartDensity::updateTable()
+{
+    if (!tableDirty)
+        return;
+
+    table.resize(tableSize);
+
+    for (int k = 0; k < tableSize; ++k)
+    {
+        QRgb color;
+
+        if (colorMap.isEmpty())
+        {
+            //малая плотность - полупрозрачный основной цвет
+            const int alpha = 48 + (255 - 48) * k / (tableSize - 1);
+            color = qRgba(mainColor.red(), mainColor.green(), mainColor.blue(), alpha);
+        }
+        else
+            color = colorMap.at(k * (colorMap.size() - 1) / (tableSize - 1));
+
+        table[k] = qPremultiply(color);
+    }
+
+    tableDirty = false;
+}
+
+void ChartDensity::colorize(const Grid& grid, const quint32* bins, const Grid& source, quint32 max_count)
+{
+    updateTable();
+
+    if (image.width() != grid.width || image.height() != grid.height)
+        image = QImage(grid.width, grid.height, QImage::Format_ARGB32_Premultiplied);
+
+    //логарифмическая шкала: единичные точки остаются видимыми рядом с плотными областями
+    const qreal scale = (tableSize - 1) / qLn(1 + qMax<quint32>(max_count, 1));
+
+    //столбцы grid, попадающие в source
+    const int x_shift = grid.left - source.left;
+    const int x_from = qBound(0, -x_shift, grid.width);
+    const int x_to = qBound(x_from, source.width - x_shift, grid.width);
+
+    for (int y = 0; y < grid.height; ++y)
+    {
+        QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+        const int source_y = grid.top + y - source.top;
+
+        if (source_y < 0 || source_y >= source.height)
+        {
+            std::fill(line, line + grid.width, QRgb(0));
+            continue;
+        }
+
+        const quint32* row = bins + source_y * source.width;
+
+        std::fill(line, line + x_from, QRgb(0));
+        std::fill(line + x_to, line + grid.width, QRgb(0));
+
+        for (int x = x_from; x < x_to; ++x)
+        {
+            const quint32 count = row[x + x_shift];
+
+            if (count == 0)
+                line[x] = 0;
+            else
+                line[x] = table.at(qBound(0, qRound(qLn(1 + count) * scale), tableSize - 1));
+        }
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef CHARTDENSITY_H
+#define CHARTDENSITY_H
+
+#include "chartseries.h"
+
+#include <QImage>
+#include <QColor>
+#include <QPainter>
+
+//режим плотности для сильно перекрывающихся точек: точки раскладываются
+//по пикселям устройства, число точек в пикселе переводится в цвет через
+//таблицу и выводится одним изображением
+class ChartDensity
+{
+public:
+    ChartDensity();
+
+    //цвета от малой плотности к большой; пустая таблица - оттенки color
+    void setColorMap(const QVector<QRgb>& colors);
+    void setColor(const QColor& color);
+
+    //indexes == NULL - все точки series начиная с first,
+    //иначе только точки из indexes с номером не меньше first
+    void paint(QPainter* painter, const ChartSeries& series, const QVector<int>* indexes, int first,
+               const QRectF& clip);
+    //накапливает счетчики всего кадра (tr - перевод данных в пиксели кадра, ratio - масштаб
+    //устройства); paint полос кадра затем только раскрашивает свою часть общих счетчиков,
+    //поэтому шкала цвета у полос одна
+    void prepare(const QTransform& tr, qreal ratio, const ChartSeries& series, const QVector<int>* indexes, int first,
+                 const QRectF& clip);
+
+private:
+    struct Grid
+    {
+        qreal xOrigin, xUnit;
+        qreal yOrigin, yUnit;
+        //левый верхний пиксель устройства и размеры
+        int left, top;
+        int width, height;
+    };
+
+    struct Chunk
+    {
+        const ChartSeries* series;
+        const Grid* grid;
+        int from, to;
+        quint32* bins;
+    };
+
+    static bool makeGrid(const QTransform& tr, qreal ratio, const QRectF& clip, Grid& grid);
+    bool frameShift(const QTransform& tr, qreal ratio, int& dx, int& dy) const;
+    void accumulateGrid(const ChartSeries& series, const QVector<int>* indexes, int first, const Grid& grid);
+    static void accumulate(const Chunk& chunk);
+    void accumulateIndexes(const ChartSeries& series, const QVector<int>& indexes, int first, const Grid& grid);
+    void accumulateParallel(const ChartSeries& series, int first, const Grid& grid);
+    void updateTable();
+    //source - сетка, по которой разложены bins; пиксели grid вне ее пустые
+    void colorize(const Grid& grid, const quint32* bins, const Grid& source, quint32 max_count);
+
+    //счетчики по пикселям и частичные буферы потоков, переиспользуются между кадрами
+    QVector<quint32> counts;
+    QVector<QVector<quint32> > partials;
+    QVector<QRgb> table;
+    QVector<QRgb> colorMap;
+    QColor mainColor;
+    bool tableDirty;
+    QImage image;
+    //счетчики подготовленного кадра, общие для копий элемента по полосам
+    QVector<quint32> frameCounts;
+    Grid frameGrid;
+    QTransform frameTransform;
+    qreal frameRatio;
+    quint32 frameMax;
+    bool framePrepared;
+};
+
+#endif // CHARTDENSITY_H
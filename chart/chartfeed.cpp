@@ -0,0 +1,115 @@
+#include "chartfeed.h"
+#include "chartdata.h"
+
+
+ChartFeed::ChartFeed(int capacity, Mode mode)
+    : mask(0),
+    md(mode),
+    writePos(0),
+    readPos(0),
+    dropped(0)
+{
+    quint32 size = 2;
+
+    while (size < (quint32)qMax(capacity, 2) && size < (1u << 30))
+        size <<= 1;
+
+    mask = size - 1;
+    cells.reset(new Cell[size]);
+
+    //ячейка i свободна для записи номер i
+    for (quint32 i = 0; i < size; ++i)
+        cells[i].sequence.storeRelease(i);
+}
+
+bool ChartFeed::push(const QPointF& point)
+{
+    quint32 pos = writePos.loadAcquire();
+    Cell* cell;
+
+    while (true)
+    {
+        cell = &cells[pos & mask];
+
+        //0 - ячейка свободна для записи pos, <0 - буфер полон, >0 - позицию заняли
+        const qint32 diff = (qint32)(cell->sequence.loadAcquire() - pos);
+
+        if (diff < 0)
+        {
+            dropped.fetchAndAddRelaxed(1);
+            return false;
+        }
+
+        if (diff == 0)
+        {
+            if (md == SingleProducer)
+            {
+                writePos.storeRelease(pos + 1);
+                break;
+            }
+
+            if (writePos.testAndSetOrdered(pos, pos + 1))
+                break;
+        }
+
+        pos = writePos.loadAcquire();
+    }
+
+    cell->point = point;
+    cell->sequence.storeRelease(pos + 1);
+
+    return true;
+}
+
+int ChartFeed::push(const QPointF* points, int count)
+{
+    int written = 0;
+
+    while (written < count && push(points[written]))
+        ++written;
+
+    //остаток не поместился
+    if (written < count - 1)
+        dropped.fetchAndAddRelaxed(count - written - 1);
+
+    return written;
+}
+
+int ChartFeed::drain(QVector<QPointF>& result, int max_count)
+{
+    int taken = 0;
+
+    //за один вызов - не больше одного оборота кольца
+    if (max_count < 0 || max_count > capacity())
+        max_count = capacity();
+
+    while (taken < max_count)
+    {
+        Cell& cell = cells[readPos & mask];
+
+        //точка еще не дописана
+        if (cell.sequence.loadAcquire() != readPos + 1)
+            break;
+
+        result.append(cell.point);
+
+        //ячейка освобождается для записи через один оборот
+        cell.sequence.storeRelease(readPos + mask + 1);
+        ++readPos;
+        ++taken;
+    }
+
+    return taken;
+}
+
+int ChartFeed::drainTo(ChartDataItem* item)
+{
+    buffer.resize(0);
+
+    const int taken = drain(buffer);
+
+    if (taken > 0)
+        item->appendData(buffer);
+
+    return taken;
+}
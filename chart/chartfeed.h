@@ -0,0 +1,61 @@
+#ifndef CHARTFEED_H
+#define CHARTFEED_H
+
+#include <QAtomicInt>
+#include <QPointF>
+#include <QVector>
+
+#include <memory>
+
+class ChartDataItem;
+
+//кольцевой буфер точек без блокировок для потоков сбора данных:
+//производители пишут из любого потока, поток GUI забирает все накопленное
+//пачкой раз в кадр (PlainChart::attachFeed). В режиме MultiProducer писать
+//могут несколько потоков одновременно, в SingleProducer - только один.
+//Ячейки помечены номером записи, поэтому читатель видит только дописанные точки
+class ChartFeed
+{
+public:
+    enum Mode { SingleProducer, MultiProducer };
+
+    //capacity округляется вверх до степени двойки
+    explicit ChartFeed(int capacity = 1 << 16, Mode mode = SingleProducer);
+
+    //поток-производитель; при переполнении точка отбрасывается и учитывается в droppedCount()
+    bool push(const QPointF& point);
+    //число записанных точек
+    int push(const QPointF* points, int count);
+
+    //только поток-потребитель: забирает до max_count точек (при -1 - не больше
+    //capacity(), чтобы быстрый производитель не удерживал читателя) в конец result
+    int drain(QVector<QPointF>& result, int max_count = -1);
+    //забирает накопленное (не больше capacity()) и дописывает в item одним вызовом
+    int drainTo(ChartDataItem* item);
+
+    int capacity() const { return mask + 1; }
+    Mode mode() const { return md; }
+    int droppedCount() const { return dropped.loadAcquire(); }
+
+private:
+    struct Cell
+    {
+        QAtomicInteger<quint32> sequence;
+        QPointF point;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    quint32 mask;
+    Mode md;
+
+    //позиции записи и чтения в разных строках кэша
+    char padWrite[64];
+    QAtomicInteger<quint32> writePos;
+    char padRead[64];
+    quint32 readPos;
+    QAtomicInt dropped;
+
+    QVector<QPointF> buffer;
+};
+
+#endif // CHARTFEED_H
@@ -0,0 +1,280 @@
+#include "chartgeometry.h"
+#include "chartkernels.h"
+
+#include <QPair>
+#include <QVector>
+
+#include <cmath>
+
+
+enum ClipEdge { LeftEdge, RightEdge, TopEdge, BottomEdge };
+
+
+//квадрат расстояния от точки до отрезка
+static inline qreal segmentDistance2(const QPointF& p, const QPointF& a, const QPointF& b)
+{
+    const qreal dx = b.x() - a.x();
+    const qreal dy = b.y() - a.y();
+    const qreal length2 = dx * dx + dy * dy;
+
+    qreal t = 0;
+
+    if (length2 > 0)
+        t = qBound<qreal>(0, ((p.x() - a.x()) * dx + (p.y() - a.y()) * dy) / length2, 1);
+
+    const qreal ex = a.x() + t * dx - p.x();
+    const qreal ey = a.y() + t * dy - p.y();
+
+    return ex * ex + ey * ey;
+}
+
+static inline bool isInside(const QPointF& p, ClipEdge edge, const QRectF& rect)
+{
+    switch (edge)
+    {
+    case LeftEdge:
+        return p.x() >= rect.left();
+    case RightEdge:
+        return p.x() <= rect.right();
+    case TopEdge:
+        return p.y() >= rect.top();
+    default:
+        return p.y() <= rect.bottom();
+    }
+}
+
+static inline QPointF intersection(const QPointF& a, const QPointF& b, ClipEdge edge, const QRectF& rect)
+{
+    if (edge == LeftEdge || edge == RightEdge)
+    {
+        const qreal x = (edge == LeftEdge) ? rect.left() : rect.right();
+        const qreal t = (x - a.x()) / (b.x() - a.x());
+
+        return QPointF(x, a.y() + t * (b.y() - a.y()));
+    }
+
+    const qreal y = (edge == TopEdge) ? rect.top() : rect.bottom();
+    const qreal t = (y - a.y()) / (b.y() - a.y());
+
+    return QPointF(a.x() + t * (b.x() - a.x()), y);
+}
+
+static void clipEdge(const QPolygonF& input, ClipEdge edge, const QRectF& rect, QPolygonF& output)
+{
+    output.clear();
+
+    if (input.isEmpty())
+        return;
+
+    QPointF prev = input.last();
+    bool prev_in = isInside(prev, edge, rect);
+
+    for (int i = 0; i < input.size(); ++i)
+    {
+        const QPointF& cur = input.at(i);
+        const bool cur_in = isInside(cur, edge, rect);
+
+        if (cur_in != prev_in)
+            output.append(intersection(prev, cur, edge, rect));
+        if (cur_in)
+            output.append(cur);
+
+        prev = cur;
+        prev_in = cur_in;
+    }
+}
+
+static inline void appendColumn(QPolygonF& result, const ChartSeries& series, int first, int last, int low, int high)
+{
+    const int mid_first = qMin(low, high);
+    const int mid_second = qMax(low, high);
+
+    result.append(series.at(first));
+    if (mid_first != first && mid_first != last)
+        result.append(series.at(mid_first));
+    if (mid_second != mid_first && mid_second != first && mid_second != last)
+        result.append(series.at(mid_second));
+    if (last != first)
+        result.append(series.at(last));
+}
+
+QPolygonF simplifyPolygon(const QPolygonF& polygon, qreal tolerance)
+{
+    //замыкающая точка, совпадающая с первой, обрабатывается отдельно
+    const bool closed = polygon.size() > 1 && polygon.first() == polygon.last();
+    const int count = closed ? polygon.size() - 1 : polygon.size();
+
+    if (count <= 4 || tolerance <= 0)
+        return polygon;
+
+    //опорные вершины: первая и самая удаленная от нее
+    int far = 0;
+    qreal far_dist = -1;
+
+    for (int i = 1; i < count; ++i)
+    {
+        const QPointF d = polygon.at(i) - polygon.at(0);
+        const qreal dist = d.x() * d.x() + d.y() * d.y();
+
+        if (dist > far_dist)
+        {
+            far = i;
+            far_dist = dist;
+        }
+    }
+
+    const qreal tolerance2 = tolerance * tolerance;
+    QVector<bool> keep(count, false);
+    QVector<QPair<int, int> > stack;
+
+    keep[0] = keep[far] = true;
+    stack.append(qMakePair(0, far));
+    stack.append(qMakePair(far, count));
+
+    //индекс count соответствует вершине 0 (контур замкнут)
+    while (!stack.isEmpty())
+    {
+        const QPair<int, int> range = stack.takeLast();
+        const QPointF& a = polygon.at(range.first);
+        const QPointF& b = polygon.at(range.second % count);
+
+        int index = -1;
+        qreal max_dist = tolerance2;
+
+        for (int i = range.first + 1; i < range.second; ++i)
+        {
+            const qreal dist = segmentDistance2(polygon.at(i), a, b);
+
+            if (dist > max_dist)
+            {
+                index = i;
+                max_dist = dist;
+            }
+        }
+
+        if (index < 0)
+            continue;
+
+        keep[index] = true;
+        stack.append(qMakePair(range.first, index));
+        stack.append(qMakePair(index, range.second));
+    }
+
+    QPolygonF result;
+
+    for (int i = 0; i < count; ++i)
+    {
+        if (keep.at(i))
+            result.append(polygon.at(i));
+    }
+
+    if (closed)
+        result.append(result.first());
+
+    return result;
+}
+
+void clipPolygon(const QPolygonF& polygon, const QRectF& rect, QPolygonF& result, QPolygonF& buffer)
+{
+    clipEdge(polygon, LeftEdge, rect, result);
+    clipEdge(result, RightEdge, rect, buffer);
+    clipEdge(buffer, TopEdge, rect, result);
+    clipEdge(result, BottomEdge, rect, buffer);
+
+    result.swap(buffer);
+}
+
+//номера столбцов считаются блоками векторным ядром
+void decimateByColumns(QPolygonF& result, const ChartSeries& series, int from, int to, qreal origin, qreal unit)
+{
+    static const int block = 1024;
+    qreal columns[block];
+
+    result.clear();
+
+    qreal column = 0;
+    int first = -1, last = -1, low = -1, high = -1;
+
+    for (int start = from; start < to; start += block)
+    {
+        const int count = qMin(block, to - start);
+
+        pixelColumns(series.xData() + start * series.stride(), count, series.stride(), origin, unit, columns);
+
+        for (int k = 0; k < count; ++k)
+        {
+            const int i = start + k;
+
+            if (first < 0 || columns[k] != column)
+            {
+                if (first >= 0)
+                    appendColumn(result, series, first, last, low, high);
+
+                column = columns[k];
+                first = last = low = high = i;
+                continue;
+            }
+
+            if (series.y(i) < series.y(low))
+                low = i;
+            if (series.y(i) > series.y(high))
+                high = i;
+            last = i;
+        }
+    }
+
+    if (first >= 0)
+        appendColumn(result, series, first, last, low, high);
+}
+
+//сетка занятых областей: списки прямоугольников по ячейкам
+void declutterRects(const QVector<QRectF>& rects, const QVector<int>& order, const QRectF& area,
+                    const QSizeF& cell, QVector<int>& result)
+{
+    result.resize(0);
+
+    if (area.isEmpty() || rects.isEmpty())
+        return;
+
+    const qreal cell_w = qMax(qreal(1), cell.width());
+    const qreal cell_h = qMax(qreal(1), cell.height());
+    const int cols = qMax(1, (int)std::ceil(area.width() / cell_w));
+    const int rows = qMax(1, (int)std::ceil(area.height() / cell_h));
+
+    QVector<int> cell_head(cols * rows, -1);
+    QVector<int> cell_next, cell_rect;
+
+    for (int i = 0; i < order.size(); ++i)
+    {
+        const int index = order.at(i);
+        const QRectF& box = rects.at(index);
+
+        //прямоугольники за пределами области места не занимают
+        if (!box.intersects(area))
+            continue;
+
+        const int c0 = qBound(0, (int)((box.left() - area.left()) / cell_w), cols - 1);
+        const int c1 = qBound(0, (int)((box.right() - area.left()) / cell_w), cols - 1);
+        const int r0 = qBound(0, (int)((box.top() - area.top()) / cell_h), rows - 1);
+        const int r1 = qBound(0, (int)((box.bottom() - area.top()) / cell_h), rows - 1);
+
+        bool is_free = true;
+        for (int r = r0; r <= r1 && is_free; ++r)
+            for (int c = c0; c <= c1 && is_free; ++c)
+                for (int e = cell_head.at(r * cols + c); e >= 0 && is_free; e = cell_next.at(e))
+                    is_free = !rects.at(cell_rect.at(e)).intersects(box);
+
+        if (!is_free)
+            continue;
+
+        result.append(index);
+
+        for (int r = r0; r <= r1; ++r)
+            for (int c = c0; c <= c1; ++c)
+            {
+                cell_rect.append(index);
+                cell_next.append(cell_head.at(r * cols + c));
+                cell_head[r * cols + c] = cell_next.size() - 1;
+            }
+    }
+}
@@ -0,0 +1,28 @@
+#ifndef CHARTGEOMETRY_H
+#define CHARTGEOMETRY_H
+
+#include "chartseries.h"
+
+#include <QPolygonF>
+#include <QRectF>
+
+//упрощение замкнутого контура (Дуглас-Пекер): вершины удаляются,
+//пока контур отклоняется от исходного не больше чем на tolerance
+QPolygonF simplifyPolygon(const QPolygonF& polygon, qreal tolerance);
+
+//отсечение контура прямоугольником (Сазерленд-Ходжмен); buffer - рабочий массив,
+//который можно переиспользовать между вызовами
+void clipPolygon(const QPolygonF& polygon, const QRectF& rect, QPolygonF& result, QPolygonF& buffer);
+
+//прореживание по столбцам пикселей (M4): для каждого столбца шириной unit от origin
+//остаются первая, последняя, минимальная и максимальная по y точки [from, to)
+//в исходном порядке; точки должны быть упорядочены по x
+void decimateByColumns(QPolygonF& result, const ChartSeries& series, int from, int to, qreal origin, qreal unit);
+
+//прореживание прямоугольников: обход в порядке order, прямоугольник остается,
+//если не пересекает оставленные ранее; прямоугольники вне area отбрасываются.
+//Пересечения ищутся по сетке ячеек размера cell от левого верхнего угла area
+void declutterRects(const QVector<QRectF>& rects, const QVector<int>& order, const QRectF& area,
+                    const QSizeF& cell, QVector<int>& result);
+
+#endif // CHARTGEOMETRY_H
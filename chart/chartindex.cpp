@@ -0,0 +1,191 @@
+#include "chartindex.h"
+
+#include <QtMath>
+
+//в среднем столько точек на ячейку
+static const int pointsPerCell = 8;
+static const int maxCellsPerSide = 1024;
+
+
+static inline bool contains(const QRectF& rect, qreal x, qreal y)
+{
+    return x >= rect.left() && x <= rect.right() && y >= rect.top() && y <= rect.bottom();
+}
+
+
+ChartGridIndex::ChartGridIndex()
+    : cellWidth(0), cellHeight(0),
+    cols(0), rows(0)
+{
+}
+
+void ChartGridIndex::build(const ChartSeries& series, const ChartBounds& area)
+{
+    clear();
+
+    const int size = series.size();
+
+    if (size == 0)
+        return;
+
+    const int side = qBound(1, qCeil(qSqrt(qreal(size) / pointsPerCell)), maxCellsPerSide);
+
+    bounds = area;
+    cols = rows = side;
+    cellWidth = (bounds.maxX - bounds.minX) / cols;
+    cellHeight = (bounds.maxY - bounds.minY) / rows;
+
+    if (cellWidth <= 0)
+        cellWidth = 1;
+    if (cellHeight <= 0)
+        cellHeight = 1;
+
+    QVector<int> cells(size);
+    cellStart.fill(0, cols * rows + 1);
+    extent = ChartBounds::empty();
+
+    for (int i = 0; i < size; ++i)
+    {
+        const qreal x = series.x(i);
+        const qreal y = series.y(i);
+
+        //точки с NaN в индекс не попадают
+        if (qIsNaN(x) || qIsNaN(y))
+        {
+            cells[i] = -1;
+            continue;
+        }
+
+        extent.minX = qMin(extent.minX, x);
+        extent.maxX = qMax(extent.maxX, x);
+        extent.minY = qMin(extent.minY, y);
+        extent.maxY = qMax(extent.maxY, y);
+
+        cells[i] = row(y) * cols + column(x);
+        ++cellStart[cells[i] + 1];
+    }
+
+    for (int c = 0; c < cols * rows; ++c)
+        cellStart[c + 1] += cellStart[c];
+
+    QVector<int> fill = cellStart;
+    order.resize(cellStart.last());
+
+    for (int i = 0; i < size; ++i)
+    {
+        if (cells.at(i) >= 0)
+            order[fill[cells.at(i)]++] = i;
+    }
+}
+
+void ChartGridIndex::clear()
+{
+    cols = rows = 0;
+    cellStart.clear();
+    order.clear();
+}
+
+void ChartGridIndex::query(const ChartSeries& series, const QRectF& rect, QVector<int>& result) const
+{
+    result.clear();
+
+    int first_col, last_col, first_row, last_row;
+
+    if (!cellRange(rect, first_col, last_col, first_row, last_row))
+        return;
+
+    for (int r = first_row; r <= last_row; ++r)
+    {
+        for (int c = first_col; c <= last_col; ++c)
+        {
+            const int cell = r * cols + c;
+
+            for (int k = cellStart.at(cell); k < cellStart.at(cell + 1); ++k)
+            {
+                const int i = order.at(k);
+
+                if (contains(rect, series.x(i), series.y(i)))
+                    result.append(i);
+            }
+        }
+    }
+}
+
+int ChartGridIndex::count(const ChartSeries& series, const QRectF& rect) const
+{
+    int first_col, last_col, first_row, last_row;
+
+    if (!cellRange(rect, first_col, last_col, first_row, last_row))
+        return 0;
+
+    int result = 0;
+
+    for (int r = first_row; r <= last_row; ++r)
+    {
+        const bool rows_inside = r > first_row && r < last_row;
+
+        for (int c = first_col; c <= last_col; ++c)
+        {
+            const int cell = r * cols + c;
+
+            //ячейка целиком внутри - точки не проверяем. Номер ячейки не убывает с ростом
+            //координаты, поэтому все точки ячеек строго между крайними лежат внутри rect
+            //без учета округления; крайние ячейки (и точки вне габаритов сетки) проверяются
+            if (rows_inside && c > first_col && c < last_col)
+            {
+                result += cellStart.at(cell + 1) - cellStart.at(cell);
+                continue;
+            }
+
+            for (int k = cellStart.at(cell); k < cellStart.at(cell + 1); ++k)
+            {
+                const int i = order.at(k);
+
+                if (contains(rect, series.x(i), series.y(i)))
+                    ++result;
+            }
+        }
+    }
+
+    return result;
+}
+
+//номер ячейки ограничиваем до приведения к int, чтобы не было переполнения
+static inline int cellOf(qreal offset, qreal cell_size, int cells)
+{
+    const qreal cell = offset / cell_size;
+
+    if (!(cell > 0))
+        return 0;
+    if (cell >= cells - 1)
+        return cells - 1;
+
+    return int(cell);
+}
+
+int ChartGridIndex::column(qreal x) const
+{
+    return cellOf(x - bounds.minX, cellWidth, cols);
+}
+
+int ChartGridIndex::row(qreal y) const
+{
+    return cellOf(y - bounds.minY, cellHeight, rows);
+}
+
+bool ChartGridIndex::cellRange(const QRectF& rect, int& first_col, int& last_col, int& first_row, int& last_row) const
+{
+    if (isEmpty())
+        return false;
+
+    if (rect.right() < extent.minX || rect.left() > extent.maxX ||
+        rect.bottom() < extent.minY || rect.top() > extent.maxY)
+        return false;
+
+    first_col = column(rect.left());
+    last_col = column(rect.right());
+    first_row = row(rect.top());
+    last_row = row(rect.bottom());
+
+    return true;
+}
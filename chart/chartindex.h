@@ -0,0 +1,39 @@
+#ifndef CHARTINDEX_H
+#define CHARTINDEX_H
+
+#include "chartseries.h"
+
+#include <QRectF>
+#include <QVector>
+
+//равномерная сетка по габаритам точек: для каждой ячейки хранится
+//непрерывный участок индексов точек (сортировка подсчетом, O(n)).
+//Габариты сетки могут быть заданы заранее (подсказкой) и не совпадать с точками:
+//точки снаружи попадают в крайние ячейки
+class ChartGridIndex
+{
+public:
+    ChartGridIndex();
+
+    void build(const ChartSeries& series, const ChartBounds& area);
+    void clear();
+
+    bool isEmpty() const { return order.isEmpty(); }
+
+    void query(const ChartSeries& series, const QRectF& rect, QVector<int>& result) const;
+    int count(const ChartSeries& series, const QRectF& rect) const;
+
+private:
+    int column(qreal x) const;
+    int row(qreal y) const;
+    bool cellRange(const QRectF& rect, int& first_col, int& last_col, int& first_row, int& last_row) const;
+
+    ChartBounds bounds;
+    ChartBounds extent; //фактические габариты проиндексированных точек
+    qreal cellWidth, cellHeight;
+    int cols, rows;
+    QVector<int> cellStart;
+    QVector<int> order;
+};
+
+#endif // CHARTINDEX_H
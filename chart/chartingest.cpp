@@ -0,0 +1,479 @@
+#include "chartingest.h"
+#include "chartdata.h"
+#include "plainchart.h"
+
+#include <QFile>
+#include <QtConcurrent>
+
+#include <cstring>
+
+
+//блок чтения по умолчанию, байт
+static const int defaultChunkSize = 1 << 20;
+
+static const double powersOf10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static inline void setError(QString* error, const QString& text)
+{
+    if (error != NULL)
+        *error = text;
+}
+
+static inline bool isDigit(char c)
+{
+    return (unsigned)(c - '0') < 10;
+}
+
+static inline bool isSeparator(char c)
+{
+    return c == ' ' || c == '\t' || c == ',' || c == ';' || c == '\r';
+}
+
+//быстрый путь - не больше 15 значащих цифр и порядок не больше 22 (тогда результат
+//округляется точно), остальное разбирает QByteArray::toDouble
+bool ChartIngest::parseNumber(const char*& p, const char* end, double& value)
+{
+    const char* start = p;
+    bool negative = false;
+
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = (*p++ == '-');
+
+    quint64 mantissa = 0;
+    int digits = 0, exponent = 0;
+    bool any = false;
+
+    for (; p < end && isDigit(*p); ++p, any = true)
+    {
+        if (digits < 19)
+        {
+            mantissa = mantissa * 10 + (*p - '0');
+            digits += (mantissa != 0);
+        }
+        else
+            ++exponent;
+    }
+
+    if (p < end && *p == '.')
+        for (++p; p < end && isDigit(*p); ++p, any = true)
+        {
+            if (digits < 19)
+            {
+                mantissa = mantissa * 10 + (*p - '0');
+                digits += (mantissa != 0);
+                --exponent;
+            }
+        }
+
+    if (!any)
+    {
+        p = start;
+        return false;
+    }
+
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        const char* mark = p++;
+        bool exp_negative = false;
+
+        if (p < end && (*p == '-' || *p == '+'))
+            exp_negative = (*p++ == '-');
+
+        if (p < end && isDigit(*p))
+        {
+            int exp_value = 0;
+
+            for (; p < end && isDigit(*p); ++p)
+                exp_value = qMin(exp_value * 10 + (*p - '0'), 100000);
+
+            exponent += exp_negative ? -exp_value : exp_value;
+        }
+        else
+            p = mark;
+    }
+
+    if (digits <= 15 && exponent >= -22 && exponent <= 22)
+    {
+        value = (exponent < 0) ? mantissa / powersOf10[-exponent] : mantissa * powersOf10[exponent];
+
+        if (negative)
+            value = -value;
+
+        return true;
+    }
+
+    bool ok = false;
+    value = QByteArray::fromRawData(start, p - start).toDouble(&ok);
+
+    return ok;
+}
+
+
+void ChartIngest::Job::fail(const QString& text)
+{
+    QMutexLocker locker(&errorMutex);
+
+    if (!failed)
+        error = text;
+
+    failed = true;
+}
+
+
+ChartIngest::ChartIngest(QObject* parent)
+    : QObject(parent),
+    target(NULL),
+    xColumn(0), yColumn(1),
+    chunkSize(defaultChunkSize),
+    running(false)
+{
+    //чтение и разбор - по потоку, общий пул остается отрисовке
+    pool.setMaxThreadCount(2);
+}
+
+ChartIngest::~ChartIngest()
+{
+    stop();
+}
+
+bool ChartIngest::start(const QString& path, ChartDataItem* item, PlainChart* chart,
+                        Format format, QString* error)
+{
+    cancel();
+
+    if (item == NULL || dynamic_cast<ChartPolygonData*>(item) != NULL)
+    {
+        setError(error, QStringLiteral("item does not support appending"));
+        return false;
+    }
+
+    QFile file(path);
+
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        setError(error, file.errorString());
+        return false;
+    }
+
+    std::shared_ptr<Job> new_job = std::make_shared<Job>();
+    new_job->path = path;
+    new_job->format = format;
+    new_job->xColumn = xColumn;
+    new_job->yColumn = yColumn;
+    new_job->chunkSize = qMax(chunkSize, 4096);
+    new_job->total = file.size();
+
+    if (format == Binary)
+    {
+        const QByteArray head = file.read(ChartDataFile::headerSize());
+
+        if (!ChartDataFile::readHeader(reinterpret_cast<const uchar*>(head.constData()),
+                                       new_job->total, new_job->header, error))
+            return false;
+    }
+
+    job = new_job;
+    target = item;
+    this->chart = chart;
+    running = true;
+
+    //элементы графика удаляются его clear() - загрузка в них прекращается
+    if (chart != NULL)
+        connect(chart, SIGNAL(dataCleared()), this, SLOT(cancel()));
+
+    target->clearData();
+
+    reader = QtConcurrent::run(&pool, &ChartIngest::readStage, job);
+    parser = QtConcurrent::run(&pool, &ChartIngest::parseStage, job, this);
+
+    return true;
+}
+
+void ChartIngest::cancel()
+{
+    const bool was_running = running;
+
+    stop();
+
+    if (was_running)
+        emit finished(false, QStringLiteral("canceled"));
+}
+
+void ChartIngest::stop()
+{
+    running = false;
+
+    if (chart != NULL)
+        disconnect(chart, SIGNAL(dataCleared()), this, SLOT(cancel()));
+
+    target = NULL;
+    chart = NULL;
+
+    if (!job)
+        return;
+
+    //ожидающие стадии просыпаются и завершаются
+    job->canceled.storeRelease(1);
+    job->raw.abort();
+    job->parsed.abort();
+
+    reader.waitForFinished();
+    parser.waitForFinished();
+
+    job.reset();
+}
+
+void ChartIngest::drain()
+{
+    if (!running || !job)
+        return;
+
+    //за вызов забирается все готовое: дозапись и перерисовка - одна на несколько пачек
+    Batch batch;
+    qint64 position = -1;
+
+    while (job->parsed.pop(batch, false))
+    {
+        target->appendData(batch.points);
+        position = batch.position;
+    }
+
+    if (position >= 0)
+    {
+        if (chart != NULL)
+            chart->replot();
+
+        emit progress(position, job->total);
+    }
+
+    if (!job->parsed.isDrained())
+        return;
+
+    const bool ok = !job->failed;
+    const QString error = job->error;
+
+    stop();
+
+    emit finished(ok, error);
+}
+
+void ChartIngest::readStage(std::shared_ptr<Job> job)
+{
+    QFile file(job->path);
+
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        job->fail(file.errorString());
+        job->raw.close();
+        return;
+    }
+
+    if (job->format == Csv)
+    {
+        //блок обрезается по последнему переводу строки, остаток уходит в следующий
+        QByteArray tail;
+        qint64 position = 0;
+
+        while (!job->canceled.loadAcquire())
+        {
+            const QByteArray block = file.read(job->chunkSize);
+
+            //пустой блок - конец файла или ошибка чтения
+            if (block.isEmpty())
+            {
+                if (file.error() != QFileDevice::NoError)
+                {
+                    job->fail(file.errorString());
+                    tail.clear();
+                }
+                break;
+            }
+
+            position += block.size();
+
+            const int cut = block.lastIndexOf('\n') + 1;
+
+            if (cut == 0)
+            {
+                tail.append(block);
+                continue;
+            }
+
+            Chunk chunk;
+            chunk.position = position - (block.size() - cut);
+
+            if (tail.isEmpty() && cut == block.size())
+                chunk.bytes = block;
+            else
+            {
+                chunk.bytes = tail;
+                chunk.bytes.append(block.constData(), cut);
+                tail = block.mid(cut);
+            }
+
+            if (!job->raw.push(std::move(chunk)))
+                break;
+        }
+
+        if (!tail.isEmpty() && !job->canceled.loadAcquire())
+        {
+            Chunk chunk;
+            chunk.bytes = tail;
+            chunk.position = position;
+            job->raw.push(std::move(chunk));
+        }
+    }
+    else
+    {
+        const ChartDataFile::Header& header = job->header;
+        const qint64 element = (header.precision == ChartDataFile::Float) ? sizeof(float) : sizeof(double);
+        const int per_chunk = qMax<qint64>(1, job->chunkSize / (2 * element));
+
+        for (int first = 0; first < header.count && !job->canceled.loadAcquire(); first += per_chunk)
+        {
+            const int count = qMin(per_chunk, header.count - first);
+            Chunk chunk;
+
+            //в столбцовом файле x и y блока лежат в разных местах
+            if (header.layout == ChartDataFile::Interleaved)
+            {
+                file.seek(header.offset + first * 2 * element);
+                chunk.bytes = file.read(count * 2 * element);
+            }
+            else
+            {
+                file.seek(header.offset + first * element);
+                chunk.bytes = file.read(count * element);
+                file.seek(header.offset + ((qint64)header.count + first) * element);
+                chunk.bytes.append(file.read(count * element));
+            }
+
+            if (chunk.bytes.size() != count * 2 * element)
+            {
+                job->fail(file.error() != QFileDevice::NoError ? file.errorString()
+                                                               : QStringLiteral("unexpected end of file"));
+                break;
+            }
+
+            chunk.position = header.offset + ((qint64)first + count) * 2 * element;
+
+            if (!job->raw.push(std::move(chunk)))
+                break;
+        }
+    }
+
+    job->raw.close();
+}
+
+void ChartIngest::parseStage(std::shared_ptr<Job> job, ChartIngest* owner)
+{
+    Chunk chunk;
+
+    while (!job->canceled.loadAcquire() && job->raw.pop(chunk))
+    {
+        Batch batch;
+        batch.position = chunk.position;
+
+        if (job->format == Csv)
+            parseCsv(*job, chunk.bytes, batch.points);
+        else
+            parseBinary(*job, chunk.bytes, batch.points);
+
+        if (batch.points.isEmpty())
+            continue;
+
+        if (!job->parsed.push(std::move(batch)))
+            break;
+
+        QMetaObject::invokeMethod(owner, "drain", Qt::QueuedConnection);
+    }
+
+    job->parsed.close();
+    QMetaObject::invokeMethod(owner, "drain", Qt::QueuedConnection);
+}
+
+void ChartIngest::parseCsv(const Job& job, const QByteArray& bytes, QVector<QPointF>& points)
+{
+    const int last_column = qMax(job.xColumn, job.yColumn);
+    const char* p = bytes.constData();
+    const char* end = p + bytes.size();
+
+    while (p < end)
+    {
+        const char* line_end = static_cast<const char*>(memchr(p, '\n', end - p));
+
+        if (line_end == NULL)
+            line_end = end;
+
+        double x = 0, y = 0;
+        bool ok = true;
+
+        for (int column = 0; column <= last_column && ok; ++column)
+        {
+            while (p < line_end && isSeparator(*p))
+                ++p;
+
+            if (p >= line_end)
+            {
+                ok = false;
+                break;
+            }
+
+            if (column != job.xColumn && column != job.yColumn)
+            {
+                while (p < line_end && !isSeparator(*p))
+                    ++p;
+                continue;
+            }
+
+            double value = 0;
+            ok = parseNumber(p, line_end, value) && (p == line_end || isSeparator(*p));
+
+            if (column == job.xColumn)
+                x = value;
+            if (column == job.yColumn)
+                y = value;
+        }
+
+        //нечисловые и неполные строки пропускаются
+        if (ok)
+            points.append(QPointF(x, y));
+
+        p = line_end + 1;
+    }
+}
+
+void ChartIngest::parseBinary(const Job& job, const QByteArray& bytes, QVector<QPointF>& points)
+{
+    const bool is_float = (job.header.precision == ChartDataFile::Float);
+    const int element = is_float ? sizeof(float) : sizeof(double);
+    const int count = bytes.size() / (2 * element);
+    const char* data = bytes.constData();
+
+    //пары (x, y) или x[count], затем y[count]
+    const int x_step = (job.header.layout == ChartDataFile::Interleaved) ? 2 * element : element;
+    const char* y_data = (job.header.layout == ChartDataFile::Interleaved) ? data + element : data + count * element;
+
+    points.resize(count);
+
+    for (int i = 0; i < count; ++i)
+    {
+        if (is_float)
+        {
+            float x, y;
+            memcpy(&x, data + i * x_step, sizeof(x));
+            memcpy(&y, y_data + i * x_step, sizeof(y));
+            points[i] = QPointF(x, y);
+        }
+        else
+        {
+            double x, y;
+            memcpy(&x, data + i * x_step, sizeof(x));
+            memcpy(&y, y_data + i * x_step, sizeof(y));
+            points[i] = QPointF(x, y);
+        }
+    }
+}
@@ -0,0 +1,185 @@
+#ifndef CHARTINGEST_H
+#define CHARTINGEST_H
+
+#include "chartdatafile.h"
+
+#include <QObject>
+#include <QFuture>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QThreadPool>
+#include <QAtomicInt>
+#include <QPointer>
+
+#include <deque>
+#include <memory>
+
+class PlainChart;
+class ChartDataItem;
+
+
+//ограниченная очередь между стадиями загрузки: push ждет места, pop - данных.
+//После close() pop отдает остаток, после abort() обе сразу возвращают false
+template <class T>
+class ChartIngestQueue
+{
+public:
+    explicit ChartIngestQueue(int capacity) : cap(capacity), closed(false), aborted(false) { }
+
+    bool push(T&& value)
+    {
+        QMutexLocker locker(&mutex);
+
+        while ((int)items.size() >= cap && !aborted)
+            notFull.wait(&mutex);
+
+        if (aborted)
+            return false;
+
+        items.push_back(std::move(value));
+        notEmpty.wakeOne();
+        return true;
+    }
+
+    //wait = false - вернуть false, если данных пока нет
+    bool pop(T& value, bool wait = true)
+    {
+        QMutexLocker locker(&mutex);
+
+        while (wait && items.empty() && !closed && !aborted)
+            notEmpty.wait(&mutex);
+
+        if (aborted || items.empty())
+            return false;
+
+        value = std::move(items.front());
+        items.pop_front();
+        notFull.wakeOne();
+        return true;
+    }
+
+    void close()
+    {
+        QMutexLocker locker(&mutex);
+        closed = true;
+        notEmpty.wakeAll();
+    }
+
+    void abort()
+    {
+        QMutexLocker locker(&mutex);
+        aborted = true;
+        items.clear();
+        notEmpty.wakeAll();
+        notFull.wakeAll();
+    }
+
+    bool isDrained() const
+    {
+        QMutexLocker locker(&mutex);
+        return aborted || (closed && items.empty());
+    }
+
+private:
+    mutable QMutex mutex;
+    QWaitCondition notEmpty, notFull;
+    std::deque<T> items;
+    int cap;
+    bool closed, aborted;
+};
+
+
+//фоновая загрузка точек из файла в элемент графика:
+//чтение блоками -> разбор -> дозапись пачками в потоке GUI с перерисовкой.
+//Очереди между стадиями ограничены, поэтому чтение не обгоняет разбор,
+//а разбор - отрисовку, больше чем на несколько блоков
+class ChartIngest : public QObject
+{
+    Q_OBJECT
+
+public:
+    //Csv - строки с числами через пробел, табуляцию, ',' или ';';
+    //нечисловые строки (заголовок, комментарии) пропускаются.
+    //Binary - формат ChartDataFile
+    enum Format { Csv, Binary };
+
+    explicit ChartIngest(QObject* parent = NULL);
+    ~ChartIngest();
+
+    //загрузка заменяет данные item; chart (если задан) перерисовывается по мере поступления,
+    //а его clear() отменяет загрузку. Без chart item должен жить до finished() или cancel()
+    bool start(const QString& path, ChartDataItem* item, PlainChart* chart = NULL,
+               Format format = Csv, QString* error = NULL);
+    bool isRunning() const { return running; }
+
+    //номера столбцов CSV для x и y
+    void setColumns(int x_column, int y_column) { xColumn = x_column; yColumn = y_column; }
+    void setChunkSize(int bytes) { chunkSize = bytes; }
+
+    //число с точкой в качестве разделителя, без учета локали; p сдвигается за число.
+    //Без цифр возвращает false и оставляет p на месте
+    static bool parseNumber(const char*& p, const char* end, double& value);
+
+public slots:
+    void cancel();
+
+signals:
+    void progress(qint64 done, qint64 total);
+    void finished(bool ok, const QString& error);
+
+private slots:
+    void drain();
+
+private:
+    struct Chunk
+    {
+        QByteArray bytes;
+        qint64 position;
+    };
+
+    struct Batch
+    {
+        QVector<QPointF> points;
+        qint64 position;
+    };
+
+    //общее для стадий состояние одной загрузки
+    struct Job
+    {
+        Job() : raw(4), parsed(4), failed(false) { }
+
+        QString path;
+        Format format;
+        int xColumn, yColumn;
+        int chunkSize;
+        qint64 total;
+        ChartDataFile::Header header;
+
+        ChartIngestQueue<Chunk> raw;
+        ChartIngestQueue<Batch> parsed;
+        QAtomicInt canceled;
+
+        QMutex errorMutex;
+        QString error;
+        bool failed;
+
+        void fail(const QString& text);
+    };
+
+    static void readStage(std::shared_ptr<Job> job);
+    static void parseStage(std::shared_ptr<Job> job, ChartIngest* owner);
+    static void parseCsv(const Job& job, const QByteArray& bytes, QVector<QPointF>& points);
+    static void parseBinary(const Job& job, const QByteArray& bytes, QVector<QPointF>& points);
+    void stop();
+
+    QThreadPool pool;
+    std::shared_ptr<Job> job;
+    QFuture<void> reader, parser;
+    ChartDataItem* target;
+    QPointer<PlainChart> chart;
+    int xColumn, yColumn;
+    int chunkSize;
+    bool running;
+};
+
+#endif // CHARTINGEST_H
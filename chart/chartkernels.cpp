@@ -0,0 +1,475 @@
+#include "chartkernels.h"
+
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CHART_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(CHART_HAVE_SSE2) && (defined(__GNUC__) || defined(_MSC_VER))
+#define CHART_HAVE_AVX2
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define CHART_TARGET_AVX2
+#else
+#define CHART_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+
+//верхняя граница уровня ветвей (setKernelLevel)
+static ChartKernelLevel kernelLimit = Avx2Kernels;
+
+//если по оси не нашлось ни одного числа, возвращаем нулевые границы
+static inline ChartBounds finishBounds(qreal min_x, qreal max_x, qreal min_y, qreal max_y)
+{
+    if (min_x > max_x)
+        min_x = max_x = 0;
+    if (min_y > max_y)
+        min_y = max_y = 0;
+
+    return ChartBounds(min_x, max_x, min_y, max_y);
+}
+
+static ChartBounds boundsScalar(const QPointF* points, int count)
+{
+    const qreal inf = std::numeric_limits<qreal>::infinity();
+    qreal min_x = inf, max_x = -inf, min_y = inf, max_y = -inf;
+
+    //сравнения с NaN ложны, поэтому такие координаты не меняют границ
+    for (int i = 0; i < count; ++i)
+    {
+        const qreal x = points[i].x();
+        const qreal y = points[i].y();
+
+        if (x < min_x) min_x = x;
+        if (x > max_x) max_x = x;
+        if (y < min_y) min_y = y;
+        if (y > max_y) max_y = y;
+    }
+
+    return finishBounds(min_x, max_x, min_y, max_y);
+}
+
+static ChartBounds boundsStrided(const qreal* x, const qreal* y, int count, int stride)
+{
+    const qreal inf = std::numeric_limits<qreal>::infinity();
+    qreal min_x = inf, max_x = -inf, min_y = inf, max_y = -inf;
+
+    for (int i = 0; i < count; ++i)
+    {
+        const qreal vx = x[i * stride];
+        const qreal vy = y[i * stride];
+
+        if (vx < min_x) min_x = vx;
+        if (vx > max_x) max_x = vx;
+        if (vy < min_y) min_y = vy;
+        if (vy > max_y) max_y = vy;
+    }
+
+    return finishBounds(min_x, max_x, min_y, max_y);
+}
+
+#ifdef CHART_HAVE_SSE2
+//в регистре лежит пара (x, y) одной точки. minpd/maxpd при NaN в любом
+//операнде возвращают второй операнд, поэтому аккумулятор передается вторым
+static ChartBounds boundsSse2(const double* xy, int count)
+{
+    const __m128d inf = _mm_set1_pd(std::numeric_limits<double>::infinity());
+    __m128d min0 = inf, min1 = inf;
+    __m128d max0 = _mm_sub_pd(_mm_setzero_pd(), inf), max1 = max0;
+
+    int i = 0;
+    for (; i + 2 <= count; i += 2)
+    {
+        const __m128d p0 = _mm_loadu_pd(xy + 2 * i);
+        const __m128d p1 = _mm_loadu_pd(xy + 2 * i + 2);
+
+        min0 = _mm_min_pd(p0, min0);
+        max0 = _mm_max_pd(p0, max0);
+        min1 = _mm_min_pd(p1, min1);
+        max1 = _mm_max_pd(p1, max1);
+    }
+
+    if (i < count)
+    {
+        const __m128d p = _mm_loadu_pd(xy + 2 * i);
+
+        min0 = _mm_min_pd(p, min0);
+        max0 = _mm_max_pd(p, max0);
+    }
+
+    double lo[2], hi[2];
+    _mm_storeu_pd(lo, _mm_min_pd(min0, min1));
+    _mm_storeu_pd(hi, _mm_max_pd(max0, max1));
+
+    return finishBounds(lo[0], hi[0], lo[1], hi[1]);
+}
+#endif
+
+#ifdef CHART_HAVE_AVX2
+//в регистре лежат две точки (x0, y0, x1, y1)
+CHART_TARGET_AVX2
+static ChartBounds boundsAvx2(const double* xy, int count)
+{
+    const __m256d inf = _mm256_set1_pd(std::numeric_limits<double>::infinity());
+    __m256d min0 = inf, min1 = inf;
+    __m256d max0 = _mm256_sub_pd(_mm256_setzero_pd(), inf), max1 = max0;
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m256d p0 = _mm256_loadu_pd(xy + 2 * i);
+        const __m256d p1 = _mm256_loadu_pd(xy + 2 * i + 4);
+
+        min0 = _mm256_min_pd(p0, min0);
+        max0 = _mm256_max_pd(p0, max0);
+        min1 = _mm256_min_pd(p1, min1);
+        max1 = _mm256_max_pd(p1, max1);
+    }
+
+    min0 = _mm256_min_pd(min0, min1);
+    max0 = _mm256_max_pd(max0, max1);
+
+    __m128d lo = _mm_min_pd(_mm256_castpd256_pd128(min0), _mm256_extractf128_pd(min0, 1));
+    __m128d hi = _mm_max_pd(_mm256_castpd256_pd128(max0), _mm256_extractf128_pd(max0, 1));
+
+    for (; i < count; ++i)
+    {
+        const __m128d p = _mm_loadu_pd(xy + 2 * i);
+
+        lo = _mm_min_pd(p, lo);
+        hi = _mm_max_pd(p, hi);
+    }
+
+    double l[2], h[2];
+    _mm_storeu_pd(l, lo);
+    _mm_storeu_pd(h, hi);
+
+    return finishBounds(l[0], h[0], l[1], h[1]);
+}
+
+static bool hasAvx2()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+
+    __cpuid(info, 1);
+    const bool os_avx = (info[2] & (1 << 27)) && (info[2] & (1 << 28));
+    if (!os_avx || (_xgetbv(0) & 0x6) != 0x6)
+        return false;
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+static inline bool useAvx2()
+{
+#ifdef CHART_HAVE_AVX2
+    static const bool avx2 = hasAvx2();
+    return avx2 && kernelLimit >= Avx2Kernels;
+#else
+    return false;
+#endif
+}
+
+//векторные ветки рассчитаны на qreal == double
+static inline bool useSse2()
+{
+#ifdef CHART_HAVE_SSE2
+    return sizeof(qreal) == sizeof(double) && kernelLimit >= Sse2Kernels;
+#else
+    return false;
+#endif
+}
+
+#ifdef CHART_HAVE_SSE2
+//раскладка по столбцам: в регистре два x или два y
+static ChartBounds boundsColumnsSse2(const double* x, const double* y, int count)
+{
+    const __m128d inf = _mm_set1_pd(std::numeric_limits<double>::infinity());
+    const __m128d neg_inf = _mm_sub_pd(_mm_setzero_pd(), inf);
+    __m128d min_x = inf, max_x = neg_inf, min_y = inf, max_y = neg_inf;
+
+    int i = 0;
+    for (; i + 2 <= count; i += 2)
+    {
+        const __m128d vx = _mm_loadu_pd(x + i);
+        const __m128d vy = _mm_loadu_pd(y + i);
+
+        min_x = _mm_min_pd(vx, min_x);
+        max_x = _mm_max_pd(vx, max_x);
+        min_y = _mm_min_pd(vy, min_y);
+        max_y = _mm_max_pd(vy, max_y);
+    }
+
+    double lx[2], hx[2], ly[2], hy[2];
+    _mm_storeu_pd(lx, min_x);
+    _mm_storeu_pd(hx, max_x);
+    _mm_storeu_pd(ly, min_y);
+    _mm_storeu_pd(hy, max_y);
+
+    double bx = std::min(lx[0], lx[1]), ex = std::max(hx[0], hx[1]);
+    double by = std::min(ly[0], ly[1]), ey = std::max(hy[0], hy[1]);
+
+    for (; i < count; ++i)
+    {
+        if (x[i] < bx) bx = x[i];
+        if (x[i] > ex) ex = x[i];
+        if (y[i] < by) by = y[i];
+        if (y[i] > ey) ey = y[i];
+    }
+
+    return finishBounds(bx, ex, by, ey);
+}
+
+static int countInRectSse2(const double* x, const double* y, int count, const QRectF& rect)
+{
+    const __m128d left = _mm_set1_pd(rect.left()), right = _mm_set1_pd(rect.right());
+    const __m128d top = _mm_set1_pd(rect.top()), bottom = _mm_set1_pd(rect.bottom());
+    static const int bits[4] = { 0, 1, 1, 2 };
+    int result = 0;
+
+    int i = 0;
+    for (; i + 2 <= count; i += 2)
+    {
+        const __m128d vx = _mm_loadu_pd(x + i);
+        const __m128d vy = _mm_loadu_pd(y + i);
+        const __m128d in_x = _mm_and_pd(_mm_cmpge_pd(vx, left), _mm_cmple_pd(vx, right));
+        const __m128d in_y = _mm_and_pd(_mm_cmpge_pd(vy, top), _mm_cmple_pd(vy, bottom));
+
+        result += bits[_mm_movemask_pd(_mm_and_pd(in_x, in_y))];
+    }
+
+    for (; i < count; ++i)
+    {
+        if (x[i] >= rect.left() && x[i] <= rect.right() && y[i] >= rect.top() && y[i] <= rect.bottom())
+            ++result;
+    }
+
+    return result;
+}
+#endif
+
+#ifdef CHART_HAVE_AVX2
+CHART_TARGET_AVX2
+static ChartBounds boundsColumnsAvx2(const double* x, const double* y, int count)
+{
+    const __m256d inf = _mm256_set1_pd(std::numeric_limits<double>::infinity());
+    const __m256d neg_inf = _mm256_sub_pd(_mm256_setzero_pd(), inf);
+    __m256d min_x = inf, max_x = neg_inf, min_y = inf, max_y = neg_inf;
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m256d vx = _mm256_loadu_pd(x + i);
+        const __m256d vy = _mm256_loadu_pd(y + i);
+
+        min_x = _mm256_min_pd(vx, min_x);
+        max_x = _mm256_max_pd(vx, max_x);
+        min_y = _mm256_min_pd(vy, min_y);
+        max_y = _mm256_max_pd(vy, max_y);
+    }
+
+    double lx[4], hx[4], ly[4], hy[4];
+    _mm256_storeu_pd(lx, min_x);
+    _mm256_storeu_pd(hx, max_x);
+    _mm256_storeu_pd(ly, min_y);
+    _mm256_storeu_pd(hy, max_y);
+
+    double bx = lx[0], ex = hx[0], by = ly[0], ey = hy[0];
+    for (int k = 1; k < 4; ++k)
+    {
+        bx = std::min(bx, lx[k]); ex = std::max(ex, hx[k]);
+        by = std::min(by, ly[k]); ey = std::max(ey, hy[k]);
+    }
+
+    for (; i < count; ++i)
+    {
+        if (x[i] < bx) bx = x[i];
+        if (x[i] > ex) ex = x[i];
+        if (y[i] < by) by = y[i];
+        if (y[i] > ey) ey = y[i];
+    }
+
+    return finishBounds(bx, ex, by, ey);
+}
+
+CHART_TARGET_AVX2
+static void pixelColumnsAvx2(const double* v, int count, double origin, double unit, double* out)
+{
+    const __m256d o = _mm256_set1_pd(origin);
+    const __m256d u = _mm256_set1_pd(unit);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m256d p = _mm256_div_pd(_mm256_sub_pd(_mm256_loadu_pd(v + i), o), u);
+        _mm256_storeu_pd(out + i, _mm256_floor_pd(p));
+    }
+
+    for (; i < count; ++i)
+        out[i] = std::floor((v[i] - origin) / unit);
+}
+
+CHART_TARGET_AVX2
+static int countInRectAvx2(const double* x, const double* y, int count, const QRectF& rect)
+{
+    const __m256d left = _mm256_set1_pd(rect.left()), right = _mm256_set1_pd(rect.right());
+    const __m256d top = _mm256_set1_pd(rect.top()), bottom = _mm256_set1_pd(rect.bottom());
+    static const int bits[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+    int result = 0;
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m256d vx = _mm256_loadu_pd(x + i);
+        const __m256d vy = _mm256_loadu_pd(y + i);
+        const __m256d in_x = _mm256_and_pd(_mm256_cmp_pd(vx, left, _CMP_GE_OQ), _mm256_cmp_pd(vx, right, _CMP_LE_OQ));
+        const __m256d in_y = _mm256_and_pd(_mm256_cmp_pd(vy, top, _CMP_GE_OQ), _mm256_cmp_pd(vy, bottom, _CMP_LE_OQ));
+
+        result += bits[_mm256_movemask_pd(_mm256_and_pd(in_x, in_y))];
+    }
+
+    for (; i < count; ++i)
+    {
+        if (x[i] >= rect.left() && x[i] <= rect.right() && y[i] >= rect.top() && y[i] <= rect.bottom())
+            ++result;
+    }
+
+    return result;
+}
+#endif
+
+
+ChartKernelLevel supportedKernelLevel()
+{
+#ifdef CHART_HAVE_AVX2
+    static const bool avx2 = hasAvx2();
+
+    if (avx2)
+        return Avx2Kernels;
+#endif
+
+#ifdef CHART_HAVE_SSE2
+    return Sse2Kernels;
+#else
+    return ScalarKernels;
+#endif
+}
+
+void setKernelLevel(ChartKernelLevel level)
+{
+    kernelLimit = level;
+}
+
+ChartKernelLevel kernelLevel()
+{
+    return qMin(kernelLimit, supportedKernelLevel());
+}
+
+ChartBounds boundsOfPoints(const QPointF* points, int count)
+{
+    if (count <= 0)
+        return ChartBounds();
+
+#ifdef CHART_HAVE_SSE2
+    if (useSse2())
+    {
+        const double* xy = reinterpret_cast<const double*>(points);
+
+#ifdef CHART_HAVE_AVX2
+        if (useAvx2())
+            return boundsAvx2(xy, count);
+#endif
+
+        return boundsSse2(xy, count);
+    }
+#endif
+
+    return boundsScalar(points, count);
+}
+
+ChartBounds boundsOfArrays(const qreal* x, const qreal* y, int count, int stride)
+{
+    if (count <= 0)
+        return ChartBounds();
+
+    //пары (x, y) подряд - раскладка QPointF
+    if (stride == 2 && y == x + 1)
+        return boundsOfPoints(reinterpret_cast<const QPointF*>(x), count);
+
+#ifdef CHART_HAVE_SSE2
+    if (stride == 1 && useSse2())
+    {
+        const double* xs = reinterpret_cast<const double*>(x);
+        const double* ys = reinterpret_cast<const double*>(y);
+
+#ifdef CHART_HAVE_AVX2
+        if (useAvx2())
+            return boundsColumnsAvx2(xs, ys, count);
+#endif
+
+        return boundsColumnsSse2(xs, ys, count);
+    }
+#endif
+
+    return boundsStrided(x, y, count, stride);
+}
+
+void pixelColumns(const qreal* values, int count, int stride, qreal origin, qreal unit, qreal* out)
+{
+#ifdef CHART_HAVE_AVX2
+    if (stride == 1 && sizeof(qreal) == sizeof(double) && useAvx2())
+    {
+        pixelColumnsAvx2(reinterpret_cast<const double*>(values), count, origin, unit,
+                         reinterpret_cast<double*>(out));
+        return;
+    }
+#endif
+
+    for (int i = 0; i < count; ++i)
+        out[i] = std::floor((values[i * stride] - origin) / unit);
+}
+
+int countInRect(const qreal* x, const qreal* y, int count, int stride, const QRectF& rect)
+{
+#ifdef CHART_HAVE_SSE2
+    if (stride == 1 && useSse2())
+    {
+        const double* xs = reinterpret_cast<const double*>(x);
+        const double* ys = reinterpret_cast<const double*>(y);
+
+#ifdef CHART_HAVE_AVX2
+        if (useAvx2())
+            return countInRectAvx2(xs, ys, count, rect);
+#endif
+
+        return countInRectSse2(xs, ys, count, rect);
+    }
+#endif
+
+    int result = 0;
+
+    for (int i = 0; i < count; ++i)
+    {
+        const qreal vx = x[i * stride];
+        const qreal vy = y[i * stride];
+
+        if (vx >= rect.left() && vx <= rect.right() && vy >= rect.top() && vy <= rect.bottom())
+            ++result;
+    }
+
+    return result;
+}
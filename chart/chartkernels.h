@@ -0,0 +1,31 @@
+#ifndef CHARTKERNELS_H
+#define CHARTKERNELS_H
+
+#include "chartbounds.h"
+
+#include <QPointF>
+#include <QRectF>
+
+//набор инструкций векторных ветвей. По умолчанию используется лучший доступный;
+//ограничение уровня нужно тестам и замерам для сравнения со скалярной веткой
+enum ChartKernelLevel { ScalarKernels, Sse2Kernels, Avx2Kernels };
+
+//лучший уровень, поддерживаемый сборкой и процессором
+ChartKernelLevel supportedKernelLevel();
+//используемый уровень не выше level; не потокобезопасно - менять до начала отрисовки
+void setKernelLevel(ChartKernelLevel level);
+ChartKernelLevel kernelLevel();
+
+//габариты набора точек за один проход; точки с NaN-координатой пропускаются
+//(по соответствующей оси). Используется AVX2 или SSE2, если процессор их поддерживает
+ChartBounds boundsOfPoints(const QPointF* points, int count);
+//то же для массивов x/y с шагом stride (в элементах qreal)
+ChartBounds boundsOfArrays(const qreal* x, const qreal* y, int count, int stride);
+
+//номера столбцов пикселей: out[i] = floor((values[i * stride] - origin) / unit)
+void pixelColumns(const qreal* values, int count, int stride, qreal origin, qreal unit, qreal* out);
+
+//число точек внутри прямоугольника (границы включаются)
+int countInRect(const qreal* x, const qreal* y, int count, int stride, const QRectF& rect);
+
+#endif // CHARTKERNELS_H
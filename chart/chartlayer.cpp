@@ -1,8 +1,12 @@
 #include "chartlayer.h"
 #include "chartlayeritem.h"
 
+#include <QPainter>
+
 
 ChartLayer::ChartLayer()
+    : cached(false),
+    valid(false)
 {
 
 }
@@ -10,14 +14,63 @@ ChartLayer::ChartLayer()
 void ChartLayer::addLayer(ChartLayerItem* newLayer)
 {
     layers.append(newLayer);
+    valid = false;
 }
 
 void ChartLayer::removeLayer(ChartLayerItem* layer)
 {
     layers.remove(layers.indexOf(layer));
+    valid = false;
+}
+
+void ChartLayer::setCached(bool enabled)
+{
+    cached = enabled;
+    valid = false;
+
+    if (!cached)
+        cache = QImage();
 }
 
 void ChartLayer::paint(QPainter* painter)
+{
+    if (!cached)
+    {
+        paintItems(painter);
+        return;
+    }
+
+    const qreal ratio = painter->device()->devicePixelRatioF();
+    const QSize size = painter->window().size() * ratio;
+
+    if (cache.size() != size || cache.devicePixelRatio() != ratio)
+    {
+        cache = QImage(size, QImage::Format_ARGB32_Premultiplied);
+        cache.setDevicePixelRatio(ratio);
+        valid = false;
+    }
+
+    if (!valid)
+    {
+        cache.fill(Qt::transparent);
+
+        QPainter cache_painter(&cache);
+        cache_painter.setRenderHints(painter->renderHints());
+        cache_painter.setFont(painter->font());
+
+        paintItems(&cache_painter);
+
+        valid = true;
+    }
+
+    const QTransform oldTr = painter->transform();
+
+    painter->resetTransform();
+    painter->drawImage(0, 0, cache);
+    painter->setTransform(oldTr);
+}
+
+void ChartLayer::paintItems(QPainter* painter)
 {
     foreach (ChartLayerItem* item, layers)
         item->paint(painter);
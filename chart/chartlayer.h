@@ -2,6 +2,7 @@
 #define CHARTLAYER_H
 
 #include <QWidget>
+#include <QImage>
 
 class ChartLayerItem;
 
@@ -15,8 +16,22 @@ public:
 
     void paint(QPainter* painter);
 
+    //при включенном кэше слой рисуется в изображение и перерисовывается
+    //только после invalidate() или изменения размера устройства
+    void setCached(bool enabled);
+    bool isCached() const { return cached; }
+    void invalidate() { valid = false; }
+    bool isValid() const { return cached && valid; }
+    //последнее изображение слоя (при включенном кэше)
+    const QImage& image() const { return cache; }
+
 private:
+    void paintItems(QPainter* painter);
+
     QVector<ChartLayerItem*> layers;
+    QImage cache;
+    bool cached;
+    bool valid;
 };
 
 #endif // CHARTLAYER_H
@@ -0,0 +1,232 @@
+#include "chartmarker.h"
+
+#include <QGuiApplication>
+#include <QThread>
+#include <QtMath>
+
+
+//x * a / 255 для всех четырех каналов сразу
+static inline uint byteMul(uint x, uint a)
+{
+    uint t = (x & 0xff00ff) * a;
+    t = (t + ((t >> 8) & 0xff00ff) + 0x800080) >> 8;
+    t &= 0xff00ff;
+
+    x = ((x >> 8) & 0xff00ff) * a;
+    x = (x + ((x >> 8) & 0xff00ff) + 0x800080);
+    x &= 0xff00ff00;
+
+    return x | t;
+}
+
+//наложение premultiplied-пикселя (SourceOver)
+static inline void blendPixel(uint& dst, uint src)
+{
+    const uint alpha = src >> 24;
+
+    if (alpha == 255)
+        dst = src;
+    else if (alpha != 0)
+        dst = src + byteMul(dst, 255 - alpha);
+}
+
+//QPixmap есть только в потоке интерфейса и только при QGuiApplication
+static inline bool isGuiThread()
+{
+    const QCoreApplication* app = QCoreApplication::instance();
+
+    return qobject_cast<const QGuiApplication*>(app) != NULL && QThread::currentThread() == app->thread();
+}
+
+
+ChartMarker::ChartMarker()
+    : sz(4),
+    spriteSx(0), spriteSy(0), spriteRatio(0),
+    spriteSize(0),
+    spriteAa(false)
+{
+}
+
+void ChartMarker::paint(QPainter* painter, const ChartSeries& series, const QVector<int>* indexes, int first,
+                        const QPen& pen, const QBrush& brush)
+{
+    const QTransform tr = painter->combinedTransform();
+    const qreal ratio = painter->device()->devicePixelRatioF();
+
+    mapCenters(tr, series, indexes, first);
+
+    if (centers.isEmpty())
+        return;
+
+    if (sz * ratio < 2)
+    {
+        paintPoints(painter, pen);
+        return;
+    }
+
+    updateSprite(tr, ratio, pen, brush, painter->testRenderHint(QPainter::Antialiasing));
+
+    if (!blitSprites(painter, ratio))
+        paintSprites(painter, ratio);
+}
+
+void ChartMarker::mapCenters(const QTransform& tr, const ChartSeries& series, const QVector<int>* indexes, int first)
+{
+    //преобразование данных в пиксели - только масштаб и сдвиг
+    const qreal m11 = tr.m11(), m22 = tr.m22();
+    const qreal dx = tr.dx(), dy = tr.dy();
+
+    centers.clear();
+
+    if (indexes == NULL)
+    {
+        centers.reserve(series.size());
+
+        for (int i = first; i < series.size(); ++i)
+            centers.append(QPointF(series.x(i) * m11 + dx, series.y(i) * m22 + dy));
+
+        return;
+    }
+
+    centers.reserve(indexes->size());
+
+    for (int k = 0; k < indexes->size(); ++k)
+    {
+        const int i = indexes->at(k);
+
+        if (i >= first)
+            centers.append(QPointF(series.x(i) * m11 + dx, series.y(i) * m22 + dy));
+    }
+}
+
+void ChartMarker::updateSprite(const QTransform& tr, qreal ratio, const QPen& pen, const QBrush& brush, bool antialias)
+{
+    const qreal sx = qAbs(tr.m11());
+    const qreal sy = qAbs(tr.m22());
+
+    if (!sprite.isNull() && sx == spriteSx && sy == spriteSy && ratio == spriteRatio && sz == spriteSize
+            && pen == spritePen && brush == spriteBrush && antialias == spriteAa)
+        return;
+
+    spriteSx = sx;
+    spriteSy = sy;
+    spriteRatio = ratio;
+    spriteSize = sz;
+    spritePen = pen;
+    spriteBrush = brush;
+    spriteAa = antialias;
+
+    //прямоугольник задается в единицах данных, как и при обычной отрисовке,
+    //поэтому обводка масштабируется по осям так же
+    const qreal w = sz / sx;
+    const qreal h = sz / sy;
+    const qreal pen_w = pen.widthF();
+    const int width = qCeil((w + pen_w) * sx * ratio) + 2;
+    const int height = qCeil((h + pen_w) * sy * ratio) + 2;
+
+    sprite = QImage(width, height, QImage::Format_ARGB32_Premultiplied);
+    sprite.fill(Qt::transparent);
+
+    QPainter sprite_painter(&sprite);
+    sprite_painter.setRenderHint(QPainter::Antialiasing, antialias);
+    sprite_painter.translate(width / 2.0, height / 2.0);
+    sprite_painter.scale(sx * ratio, sy * ratio);
+    sprite_painter.setPen(pen);
+    sprite_painter.setBrush(brush);
+    sprite_painter.drawRect(QRectF(-w / 2, -h / 2, w, h));
+    sprite_painter.end();
+
+    spritePixmap = QPixmap();
+}
+
+void ChartMarker::paintPoints(QPainter* painter, const QPen& pen)
+{
+    QPen point_pen(pen.color(), sz * 1.5, Qt::SolidLine, Qt::SquareCap);
+
+    painter->save();
+    painter->resetTransform();
+    painter->setViewTransformEnabled(false);
+    painter->setPen(point_pen);
+    painter->drawPoints(centers.constData(), centers.size());
+    painter->restore();
+}
+
+bool ChartMarker::blitSprites(QPainter* painter, qreal ratio)
+{
+    //прямой перенос возможен только в собственное изображение без отсечения и прозрачности
+    if (painter->device()->devType() != QInternal::Image)
+        return false;
+
+    QImage* image = static_cast<QImage*>(painter->device());
+
+    if (image->format() != QImage::Format_ARGB32_Premultiplied || !image->isDetached() || painter->hasClipping()
+            || painter->compositionMode() != QPainter::CompositionMode_SourceOver || painter->opacity() != 1)
+        return false;
+
+    const int image_w = image->width();
+    const int image_h = image->height();
+    const int bpl = image->bytesPerLine();
+    const int sprite_w = sprite.width();
+    const int sprite_h = sprite.height();
+    uchar* bits = image->bits();
+
+    for (int k = 0; k < centers.size(); ++k)
+    {
+        const int left = qFloor(centers.at(k).x() * ratio - sprite_w / 2.0 + 0.5);
+        const int top = qFloor(centers.at(k).y() * ratio - sprite_h / 2.0 + 0.5);
+
+        const int x0 = qMax(0, -left);
+        const int x1 = qMin(sprite_w, image_w - left);
+        const int y0 = qMax(0, -top);
+        const int y1 = qMin(sprite_h, image_h - top);
+
+        if (x0 >= x1 || y0 >= y1)
+            continue;
+
+        for (int y = y0; y < y1; ++y)
+        {
+            const uint* src = reinterpret_cast<const uint*>(sprite.constScanLine(y));
+            uint* dst = reinterpret_cast<uint*>(bits + (top + y) * bpl) + left;
+
+            for (int x = x0; x < x1; ++x)
+                blendPixel(dst[x], src[x]);
+        }
+    }
+
+    return true;
+}
+
+void ChartMarker::paintSprites(QPainter* painter, qreal ratio)
+{
+    const qreal sprite_w = sprite.width();
+    const qreal sprite_h = sprite.height();
+
+    painter->save();
+    painter->resetTransform();
+    painter->setViewTransformEnabled(false);
+
+    //QPixmap можно использовать только в потоке интерфейса
+    if (isGuiThread())
+    {
+        if (spritePixmap.isNull())
+            spritePixmap = QPixmap::fromImage(sprite);
+
+        const QRectF source(0, 0, sprite_w, sprite_h);
+
+        fragments.resize(centers.size());
+        for (int k = 0; k < centers.size(); ++k)
+            fragments[k] = QPainter::PixmapFragment::create(centers.at(k), source, 1 / ratio, 1 / ratio);
+
+        painter->drawPixmapFragments(fragments.constData(), fragments.size(), spritePixmap);
+    }
+    else
+    {
+        const qreal w = sprite_w / ratio;
+        const qreal h = sprite_h / ratio;
+
+        for (int k = 0; k < centers.size(); ++k)
+            painter->drawImage(QRectF(centers.at(k).x() - w / 2, centers.at(k).y() - h / 2, w, h), sprite);
+    }
+
+    painter->restore();
+}
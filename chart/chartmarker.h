@@ -0,0 +1,49 @@
+#ifndef CHARTMARKER_H
+#define CHARTMARKER_H
+
+#include "chartseries.h"
+
+#include <QImage>
+#include <QPixmap>
+#include <QPainter>
+#include <QPen>
+
+//отрисовка одинаковых маркеров-прямоугольников: форма один раз рисуется
+//в спрайт текущего размера и переносится во все точки одним проходом
+class ChartMarker
+{
+public:
+    ChartMarker();
+
+    //размер прямоугольника маркера в пикселях; маркеры меньше 2 пикселей
+    //рисуются одним вызовом drawPoints
+    void setSize(qreal pixels) { sz = pixels; }
+    qreal size() const { return sz; }
+
+    //indexes == NULL - все точки series начиная с first,
+    //иначе только точки из indexes с номером не меньше first
+    void paint(QPainter* painter, const ChartSeries& series, const QVector<int>* indexes, int first,
+               const QPen& pen, const QBrush& brush);
+
+private:
+    void mapCenters(const QTransform& tr, const ChartSeries& series, const QVector<int>* indexes, int first);
+    void updateSprite(const QTransform& tr, qreal ratio, const QPen& pen, const QBrush& brush, bool antialias);
+    void paintPoints(QPainter* painter, const QPen& pen);
+    bool blitSprites(QPainter* painter, qreal ratio);
+    void paintSprites(QPainter* painter, qreal ratio);
+
+    qreal sz;
+    QVector<QPointF> centers;
+    QVector<QPainter::PixmapFragment> fragments;
+
+    //спрайт и параметры, для которых он построен
+    QImage sprite;
+    QPixmap spritePixmap;
+    qreal spriteSx, spriteSy, spriteRatio;
+    qreal spriteSize;
+    QPen spritePen;
+    QBrush spriteBrush;
+    bool spriteAa;
+};
+
+#endif // CHARTMARKER_H
@@ -0,0 +1,165 @@
+#include "chartpyramid.h"
+
+//точек в блоке нижнего уровня и блоков уровня в блоке следующего
+static const int pyramidBase = 16;
+static const int pyramidFactor = 4;
+
+
+ChartPyramid::ChartPyramid()
+    : cnt(0)
+{
+}
+
+void ChartPyramid::clear()
+{
+    levels.clear();
+    cnt = 0;
+}
+
+qint64 ChartPyramid::bucketSize(int level) const
+{
+    return (qint64)pyramidBase << (2 * level);
+}
+
+int ChartPyramid::levelFor(qreal max_bucket) const
+{
+    int level = -1;
+
+    while (level + 1 < levels.size() && bucketSize(level + 1) <= max_bucket)
+        ++level;
+
+    return level;
+}
+
+void ChartPyramid::update(const ChartSeries& series)
+{
+    const int total = series.size();
+
+    if (total < cnt)
+        clear();
+
+    if (total == cnt)
+        return;
+
+    //последний блок мог быть неполным - пересчитываем с него
+    int changed = cnt / pyramidBase;
+
+    if (levels.isEmpty())
+        levels.resize(1);
+
+    updateBase(series, changed);
+
+    for (int level = 1; levels.at(level - 1).size() > 4; ++level)
+    {
+        if (levels.size() <= level)
+            levels.resize(level + 1);
+
+        changed = qMin(changed / pyramidFactor, levels.at(level).size() / 4);
+        updateLevel(series, level, changed);
+    }
+
+    cnt = total;
+}
+
+void ChartPyramid::updateBase(const ChartSeries& series, int changed)
+{
+    const int total = series.size();
+    QVector<int>& base = levels[0];
+
+    base.resize(changed * 4);
+    base.reserve((total + pyramidBase - 1) / pyramidBase * 4);
+
+    for (int from = changed * pyramidBase; from < total; from += pyramidBase)
+    {
+        const int to = qMin(from + pyramidBase, total);
+        int low = from, high = from;
+
+        for (int i = from + 1; i < to; ++i)
+        {
+            const qreal y = series.y(i);
+
+            if (y < series.y(low))
+                low = i;
+            if (y > series.y(high))
+                high = i;
+        }
+
+        base.append(from);
+        base.append(to - 1);
+        base.append(low);
+        base.append(high);
+    }
+}
+
+void ChartPyramid::updateLevel(const ChartSeries& series, int level, int changed)
+{
+    //сначала неконстантный доступ: он может отсоединить копию пирамиды
+    QVector<int>& parent = levels[level];
+    const QVector<int>& child = levels.at(level - 1);
+    const int child_count = child.size() / 4;
+
+    parent.resize(changed * 4);
+    parent.reserve((child_count + pyramidFactor - 1) / pyramidFactor * 4);
+
+    for (int first = changed * pyramidFactor; first < child_count; first += pyramidFactor)
+    {
+        const int last = qMin(first + pyramidFactor, child_count) - 1;
+        int low = child.at(first * 4 + 2);
+        int high = child.at(first * 4 + 3);
+
+        for (int b = first + 1; b <= last; ++b)
+        {
+            const int b_low = child.at(b * 4 + 2);
+            const int b_high = child.at(b * 4 + 3);
+
+            if (series.y(b_low) < series.y(low))
+                low = b_low;
+            if (series.y(b_high) > series.y(high))
+                high = b_high;
+        }
+
+        parent.append(child.at(first * 4));
+        parent.append(child.at(last * 4 + 1));
+        parent.append(low);
+        parent.append(high);
+    }
+}
+
+void ChartPyramid::collect(const ChartSeries& series, int level, int from, int to, QPolygonF& result) const
+{
+    result.resize(0);
+
+    const QVector<int>& reps = levels.at(level);
+    const qint64 size = bucketSize(level);
+    const int first_bucket = from / size;
+    const int last_bucket = qMin<qint64>((to - 1) / size, reps.size() / 4 - 1);
+
+    for (int b = first_bucket; b <= last_bucket; ++b)
+    {
+        const int first = reps.at(b * 4);
+        const int last = reps.at(b * 4 + 1);
+        const int low = reps.at(b * 4 + 2);
+        const int high = reps.at(b * 4 + 3);
+        const int a = qMin(low, high);
+        const int c = qMax(low, high);
+
+        //first <= a <= c <= last, повторы пропускаем
+        result.append(series.at(first));
+        if (a > first)
+            result.append(series.at(a));
+        if (c > a)
+            result.append(series.at(c));
+        if (last > c)
+            result.append(series.at(last));
+    }
+}
+
+qint64 ChartPyramid::memoryUsage() const
+{
+    qint64 bytes = sizeof(*this) + levels.capacity() * sizeof(QVector<int>);
+
+    for (int i = 0; i < levels.size(); ++i)
+        bytes += levels.at(i).capacity() * sizeof(int);
+
+    return bytes;
+}
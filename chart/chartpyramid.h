@@ -0,0 +1,42 @@
+#ifndef CHARTPYRAMID_H
+#define CHARTPYRAMID_H
+
+#include "chartseries.h"
+
+#include <QPolygonF>
+#include <QVector>
+
+//пирамида прореживания серии, упорядоченной по x: уровень k делит точки на блоки
+//по 16 * 4^k подряд идущих точек и хранит для каждого блока номера первой, последней,
+//минимальной и максимальной по y точек. При дозаписи пересчитываются только
+//последние (неполные) блоки каждого уровня
+class ChartPyramid
+{
+public:
+    ChartPyramid();
+
+    //досчитывает пирамиду до series.size(); первые count() точек не должны меняться
+    void update(const ChartSeries& series);
+    void clear();
+
+    int count() const { return cnt; }
+    int levelCount() const { return levels.size(); }
+    qint64 bucketSize(int level) const;
+    //самый грубый уровень с блоками не крупнее max_bucket точек, -1 если такого нет
+    int levelFor(qreal max_bucket) const;
+    //опорные точки блоков уровня level, пересекающихся с [from, to), в порядке номеров
+    void collect(const ChartSeries& series, int level, int from, int to, QPolygonF& result) const;
+
+    //занимаемая память, байт
+    qint64 memoryUsage() const;
+
+private:
+    void updateBase(const ChartSeries& series, int changed);
+    void updateLevel(const ChartSeries& series, int level, int changed);
+
+    //по 4 номера на блок: первая, последняя, минимум, максимум
+    QVector<QVector<int> > levels;
+    int cnt;
+};
+
+#endif // CHARTPYRAMID_H
@@ -0,0 +1,236 @@
+#include "chartrenderer.h"
+
+#include <QtConcurrent>
+#include <QThreadPool>
+#include <QtMath>
+
+#include <cstring>
+
+
+//более узкие полосы не окупают копирование элементов
+static const int minTileWidth = 128;
+
+
+ChartRenderer::ChartRenderer(QObject* parent)
+    : QObject(parent),
+    watcher(new QFutureWatcher<QImage>(this)),
+    generation(0),
+    hasPending(false),
+    tiled(true)
+{
+    connect(watcher, SIGNAL(finished()), this, SLOT(finished()));
+}
+
+ChartRenderer::~ChartRenderer()
+{
+    cancel();
+    watcher->waitForFinished();
+}
+
+void ChartRenderer::render(const QVector<ChartDataItem*>& items, const ChartProjection& proj,
+                           const QSize& size, qreal ratio, QPainter::RenderHints hints)
+{
+    Job job;
+    job.items = items;
+    job.proj = proj;
+    job.size = size;
+    job.ratio = ratio;
+    job.hints = hints;
+    job.generation = generation.fetchAndAddOrdered(1) + 1;
+    job.tiled = tiled;
+
+    if (hasPending)
+        deleteItems(pending.items);
+
+    //текущий кадр устарел - прерываем его и ждем завершения,
+    //чтобы не держать в памяти больше двух копий данных
+    if (watcher->isRunning())
+    {
+        pending = job;
+        hasPending = true;
+        return;
+    }
+
+    hasPending = false;
+    start(job);
+}
+
+void ChartRenderer::cancel()
+{
+    generation.fetchAndAddOrdered(1);
+
+    if (hasPending)
+    {
+        deleteItems(pending.items);
+        hasPending = false;
+    }
+}
+
+void ChartRenderer::setFrame(const QImage& frame, const ChartProjection& proj)
+{
+    lastFrame = frame;
+    lastProjection = proj;
+}
+
+void ChartRenderer::finished()
+{
+    const QImage image = watcher->result();
+
+    if (!image.isNull() && running.generation == generation.loadAcquire())
+    {
+        lastFrame = image;
+        lastProjection = running.proj;
+        emit frameReady();
+    }
+
+    if (hasPending)
+    {
+        hasPending = false;
+        start(pending);
+    }
+}
+
+void ChartRenderer::start(const Job& job)
+{
+    running = job;
+    running.items.clear();
+
+    watcher->setFuture(QtConcurrent::run(&ChartRenderer::renderJob, job, &generation));
+}
+
+QImage ChartRenderer::renderJob(Job job, const QAtomicInt* generation)
+{
+    const int count = tileCount(job);
+    const int width = job.size.width();
+
+    //расчеты по всей видимой области делаются один раз до копирования по полосам
+    for (int i = 0; i < job.items.size(); ++i)
+        ChartData::prepareItem(job.items.at(i), job.proj, job.ratio);
+
+    QVector<Tile> tiles(count);
+
+    for (int i = 0; i < count; ++i)
+    {
+        Tile& tile = tiles[i];
+        tile.job = &job;
+        tile.generation = generation;
+        tile.left = width * i / count;
+        tile.width = width * (i + 1) / count - tile.left;
+
+        //элементы хранят промежуточные данные отрисовки,
+        //поэтому каждой полосе нужна своя копия
+        tile.items = (i == 0) ? job.items : cloneItems(job.items);
+    }
+
+    if (count == 1)
+    {
+        renderTile(tiles[0]);
+        return tiles[0].image;
+    }
+
+    QtConcurrent::blockingMap(tiles, &ChartRenderer::renderTile);
+
+    QImage image(job.size * job.ratio, QImage::Format_ARGB32_Premultiplied);
+    image.setDevicePixelRatio(job.ratio);
+
+    for (int i = 0; i < count; ++i)
+    {
+        const QImage& part = tiles.at(i).image;
+
+        //кадр отменен
+        if (part.isNull())
+            return QImage();
+
+        const int offset = qRound(tiles.at(i).left * job.ratio) * 4;
+
+        for (int y = 0; y < part.height(); ++y)
+            memcpy(image.scanLine(y) + offset, part.constScanLine(y), part.width() * 4);
+    }
+
+    return image;
+}
+
+void ChartRenderer::renderTile(Tile& tile)
+{
+    const Job& job = *tile.job;
+    const bool whole = (tile.width == job.size.width());
+
+    tile.image = QImage(QSize(tile.width, job.size.height()) * job.ratio, QImage::Format_ARGB32_Premultiplied);
+    tile.image.setDevicePixelRatio(job.ratio);
+    tile.image.fill(Qt::transparent);
+
+    QPainter painter(&tile.image);
+    painter.setRenderHints(job.hints);
+
+    //логические координаты полосы совпадают с координатами всего кадра со сдвигом,
+    //поэтому пиксели на ее территории те же, что и при отрисовке кадра целиком
+    painter.setViewport(-tile.left, 0, job.size.width(), job.size.height());
+    ChartData::initPainter(&painter, job.proj);
+
+    const QRectF clip = whole ? QRectF() : tileClip(job.proj, tile.left, tile.width);
+
+    for (int i = 0; i < tile.items.size(); ++i)
+    {
+        //запрошен более новый кадр
+        if (tile.generation->loadAcquire() != job.generation)
+        {
+            painter.end();
+            tile.image = QImage();
+            break;
+        }
+
+        ChartData::paintItem(&painter, tile.items.at(i), job.proj, clip);
+    }
+
+    if (painter.isActive())
+        painter.end();
+
+    deleteItems(tile.items);
+}
+
+int ChartRenderer::tileCount(const Job& job)
+{
+    //склейка полос попиксельная, поэтому нужен целый масштаб устройства
+    if (!job.tiled || job.ratio != qFloor(job.ratio))
+        return 1;
+
+    const int threads = QThreadPool::globalInstance()->maxThreadCount();
+
+    return qMax(1, qMin(threads, job.size.width() / minTileWidth));
+}
+
+QRectF ChartRenderer::tileClip(const ChartProjection& proj, int left, int width)
+{
+    const QRectF& window = proj.window;
+    qreal x0, x1;
+
+    if (proj.xInverted)
+    {
+        x0 = window.right() - (left + width) * proj.xScale;
+        x1 = window.right() - left * proj.xScale;
+    }
+    else
+    {
+        x0 = window.left() + left * proj.xScale;
+        x1 = window.left() + (left + width) * proj.xScale;
+    }
+
+    return QRectF(x0, window.top(), x1 - x0, window.height());
+}
+
+QVector<ChartDataItem*> ChartRenderer::cloneItems(const QVector<ChartDataItem*>& items)
+{
+    QVector<ChartDataItem*> result;
+    result.reserve(items.size());
+
+    for (int i = 0; i < items.size(); ++i)
+        result.append(items.at(i)->clone());
+
+    return result;
+}
+
+void ChartRenderer::deleteItems(QVector<ChartDataItem*>& items)
+{
+    qDeleteAll(items);
+    items.clear();
+}
@@ -0,0 +1,81 @@
+#ifndef CHARTRENDERER_H
+#define CHARTRENDERER_H
+
+#include "chartdata.h"
+
+#include <QObject>
+#include <QImage>
+#include <QPainter>
+#include <QFutureWatcher>
+#include <QAtomicInt>
+
+//фоновая отрисовка слоя данных: элементы копируются в момент запроса,
+//кадр рисуется в пуле потоков, виджет показывает последний готовый кадр.
+//Широкий кадр делится на вертикальные полосы, которые рисуются параллельно
+//и затем склеиваются
+class ChartRenderer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ChartRenderer(QObject* parent = NULL);
+    ~ChartRenderer();
+
+    //забирает владение items; более ранний незавершенный запрос отменяется
+    void render(const QVector<ChartDataItem*>& items, const ChartProjection& proj,
+                const QSize& size, qreal ratio, QPainter::RenderHints hints);
+    void cancel();
+    void setTiled(bool enabled) { tiled = enabled; }
+    //подменяет последний кадр готовым изображением (например, кэшем слоя)
+    void setFrame(const QImage& frame, const ChartProjection& proj);
+
+    const QImage& frame() const { return lastFrame; }
+    const ChartProjection& frameProjection() const { return lastProjection; }
+    bool isBusy() const { return watcher->isRunning(); }
+
+signals:
+    void frameReady();
+
+private slots:
+    void finished();
+
+private:
+    struct Job
+    {
+        QVector<ChartDataItem*> items;
+        ChartProjection proj;
+        QSize size;
+        qreal ratio;
+        QPainter::RenderHints hints;
+        int generation;
+        bool tiled;
+    };
+
+    struct Tile
+    {
+        const Job* job;
+        const QAtomicInt* generation;
+        QVector<ChartDataItem*> items;
+        int left, width;
+        QImage image;
+    };
+
+    static QImage renderJob(Job job, const QAtomicInt* generation);
+    static void renderTile(Tile& tile);
+    static int tileCount(const Job& job);
+    static QRectF tileClip(const ChartProjection& proj, int left, int width);
+    static QVector<ChartDataItem*> cloneItems(const QVector<ChartDataItem*>& items);
+    static void deleteItems(QVector<ChartDataItem*>& items);
+    void start(const Job& job);
+
+    QFutureWatcher<QImage>* watcher;
+    QAtomicInt generation;
+    Job running;
+    Job pending;
+    bool hasPending;
+    bool tiled;
+    QImage lastFrame;
+    ChartProjection lastProjection;
+};
+
+#endif // CHARTRENDERER_H
@@ -0,0 +1,425 @@
+#include "chartseries.h"
+#include "chartkernels.h"
+
+#include <QtMath>
+
+#include <cstring>
+
+
+template <class T>
+static inline void pushMin(std::deque<T>& queue, const T& item)
+{
+    while (!queue.empty() && queue.back().value >= item.value)
+        queue.pop_back();
+
+    queue.push_back(item);
+}
+
+template <class T>
+static inline void pushMax(std::deque<T>& queue, const T& item)
+{
+    while (!queue.empty() && queue.back().value <= item.value)
+        queue.pop_back();
+
+    queue.push_back(item);
+}
+
+template <class T>
+static inline void popBefore(std::deque<T>& queue, qint64 index)
+{
+    while (!queue.empty() && queue.front().index < index)
+        queue.pop_front();
+}
+
+
+//выравнивание столбцов под самый широкий векторный регистр
+static const int columnAlignment = 64;
+
+
+void ChartColumn::removeFirst(int count)
+{
+    count = qMin(count, sz);
+
+    if (count <= 0)
+        return;
+
+    //общий буфер не трогаем - переносим хвост в собственный
+    if (buf.use_count() > 1)
+    {
+        qreal* new_buf = static_cast<qreal*>(qMallocAligned(cap * sizeof(qreal), columnAlignment));
+        memcpy(new_buf, buf.get() + count, (sz - count) * sizeof(qreal));
+        buf.reset(new_buf, qFreeAligned);
+    }
+    else
+        memmove(buf.get(), buf.get() + count, (sz - count) * sizeof(qreal));
+
+    sz -= count;
+}
+
+void ChartColumn::clear()
+{
+    if (buf.use_count() > 1)
+    {
+        buf.reset();
+        cap = 0;
+    }
+
+    sz = 0;
+}
+
+void ChartColumn::reserve(int newCapacity)
+{
+    if (newCapacity <= cap)
+        return;
+
+    detach(newCapacity);
+}
+
+void ChartColumn::detach(int newCapacity)
+{
+    qreal* new_buf = static_cast<qreal*>(qMallocAligned(newCapacity * sizeof(qreal), columnAlignment));
+
+    if (sz > 0)
+        memcpy(new_buf, buf.get(), sz * sizeof(qreal));
+
+    buf.reset(new_buf, qFreeAligned);
+    cap = newCapacity;
+}
+
+
+ChartSeries::ChartSeries()
+    : lay(Interleaved),
+    head(0),
+    cap(0),
+    dropped(0),
+    xp(NULL), yp(NULL),
+    st(2),
+    cnt(0),
+    ext(false)
+{
+    updatePointers();
+}
+
+ChartSeries::ChartSeries(const ChartSeries& other)
+{
+    *this = other;
+}
+
+ChartSeries& ChartSeries::operator=(const ChartSeries& other)
+{
+    lay = other.lay;
+    pts = other.pts;
+    xs = other.xs;
+    ys = other.ys;
+    head = other.head;
+    cap = other.cap;
+    dropped = other.dropped;
+    xp = other.xp;
+    yp = other.yp;
+    st = other.st;
+    cnt = other.cnt;
+    ext = other.ext;
+    keepAlive = other.keepAlive;
+    minX = other.minX; maxX = other.maxX;
+    minY = other.minY; maxY = other.maxY;
+
+    //собственные данные разделяются с other до первого изменения (копирование при записи),
+    //а не копируются; указатели пересчитываются по своему хранилищу
+    updatePointers();
+
+    return *this;
+}
+
+void ChartSeries::setData(const QVector<QPointF>& data)
+{
+    QVector<QPointF> copy = data;
+
+    setData(std::move(copy));
+}
+
+void ChartSeries::setData(QVector<QPointF>&& data)
+{
+    head = 0;
+    dropped = 0;
+    ext = false;
+    keepAlive.reset();
+    store(std::move(data));
+
+    if (cap > 0)
+    {
+        trim();
+        rebuildExtremes();
+    }
+}
+
+void ChartSeries::setExternal(const qreal* x_data, const qreal* y_data, int count, int stride,
+                              const std::shared_ptr<const void>& keep_alive)
+{
+    pts.clear();
+    xs.clear();
+    ys.clear();
+    head = 0;
+    dropped = 0;
+
+    xp = x_data;
+    yp = y_data;
+    st = stride;
+    cnt = qMax(count, 0);
+    ext = true;
+    keepAlive = keep_alive;
+
+    if (cap > 0)
+    {
+        trim();
+        rebuildExtremes();
+    }
+}
+
+void ChartSeries::append(const QPointF& point)
+{
+    append(&point, 1);
+}
+
+void ChartSeries::append(const QPointF* data, int count)
+{
+    if (count <= 0)
+        return;
+
+    //во внешний массив дописать нельзя - переходим на собственную копию
+    detach();
+
+    //при заполненном окне сначала освобождаем место, чтобы не расти до 2x
+    if (cap > 0 && count >= cap)
+    {
+        data += count - cap;
+        count = cap;
+    }
+
+    const int first = size();
+
+    for (int i = 0; i < count; ++i)
+    {
+        if (lay == Interleaved)
+            pts.append(data[i]);
+        else
+        {
+            xs.append(data[i].x());
+            ys.append(data[i].y());
+        }
+    }
+
+    updatePointers();
+
+    if (cap > 0)
+    {
+        for (int i = 0; i < count; ++i)
+            pushExtremes(dropped + first + i, data[i]);
+
+        trim();
+    }
+}
+
+void ChartSeries::clear()
+{
+    pts.clear();
+    xs.clear();
+    ys.clear();
+    head = 0;
+    dropped = 0;
+    ext = false;
+    keepAlive.reset();
+    updatePointers();
+
+    minX.clear(); maxX.clear();
+    minY.clear(); maxY.clear();
+}
+
+void ChartSeries::setCapacity(int newCapacity)
+{
+    cap = qMax(newCapacity, 0);
+
+    if (cap > 0)
+    {
+        trim();
+        rebuildExtremes();
+    }
+    else
+    {
+        minX.clear(); maxX.clear();
+        minY.clear(); maxY.clear();
+    }
+}
+
+void ChartSeries::setLayout(Layout newLayout)
+{
+    if (newLayout == lay)
+        return;
+
+    //внешние данные остаются как есть, раскладка применится при переходе на копию
+    if (ext)
+    {
+        lay = newLayout;
+        return;
+    }
+
+    QVector<QPointF> data = toVector();
+
+    lay = newLayout;
+    head = 0;
+    store(std::move(data));
+}
+
+QVector<QPointF> ChartSeries::toVector() const
+{
+    if (!ext && lay == Interleaved && head == 0)
+        return pts;
+
+    QVector<QPointF> result;
+    result.reserve(cnt);
+
+    for (int i = 0; i < cnt; ++i)
+        result.append(at(i));
+
+    return result;
+}
+
+ChartBounds ChartSeries::bounds(int from, int count) const
+{
+    return boundsOfArrays(xp + from * st, yp + from * st, count, st);
+}
+
+ChartBounds ChartSeries::windowBounds() const
+{
+    if (minX.empty() || minY.empty())
+        return ChartBounds();
+
+    return ChartBounds(minX.front().value, maxX.front().value, minY.front().value, maxY.front().value);
+}
+
+void ChartSeries::store(QVector<QPointF>&& data)
+{
+    if (lay == Interleaved)
+    {
+        pts = std::move(data);
+        xs.clear();
+        ys.clear();
+    }
+    else
+    {
+        pts.clear();
+        xs.clear();
+        ys.clear();
+        xs.reserve(data.size());
+        ys.reserve(data.size());
+
+        for (int i = 0; i < data.size(); ++i)
+        {
+            xs.append(data.at(i).x());
+            ys.append(data.at(i).y());
+        }
+    }
+
+    updatePointers();
+}
+
+void ChartSeries::detach()
+{
+    if (!ext)
+        return;
+
+    QVector<QPointF> data = toVector();
+
+    head = 0;
+    ext = false;
+    keepAlive.reset();
+    store(std::move(data));
+}
+
+void ChartSeries::updatePointers()
+{
+    if (ext)
+        return;
+
+    if (lay == Interleaved)
+    {
+        const qreal* base = reinterpret_cast<const qreal*>(pts.constData() + head);
+
+        xp = base;
+        yp = base + 1;
+        st = 2;
+    }
+    else
+    {
+        xp = xs.data() + head;
+        yp = ys.data() + head;
+        st = 1;
+    }
+
+    cnt = storedSize() - head;
+}
+
+void ChartSeries::trim()
+{
+    const int extra = size() - cap;
+
+    if (extra <= 0)
+        return;
+
+    dropped += extra;
+
+    popBefore(minX, dropped); popBefore(maxX, dropped);
+    popBefore(minY, dropped); popBefore(maxY, dropped);
+
+    //внешнее окно просто сдвигаем
+    if (ext)
+    {
+        xp += extra * st;
+        yp += extra * st;
+        cnt -= extra;
+        return;
+    }
+
+    head += extra;
+
+    //сдвигаем хранилище не чаще одного раза на cap дозаписей
+    if (head >= cap)
+    {
+        if (lay == Interleaved)
+            pts.remove(0, head);
+        else
+        {
+            xs.removeFirst(head);
+            ys.removeFirst(head);
+        }
+
+        head = 0;
+    }
+
+    updatePointers();
+}
+
+void ChartSeries::pushExtremes(qint64 index, const QPointF& point)
+{
+    if (!qIsNaN(point.x()))
+    {
+        const Extremum item = { index, point.x() };
+        pushMin(minX, item);
+        pushMax(maxX, item);
+    }
+
+    if (!qIsNaN(point.y()))
+    {
+        const Extremum item = { index, point.y() };
+        pushMin(minY, item);
+        pushMax(maxY, item);
+    }
+}
+
+void ChartSeries::rebuildExtremes()
+{
+    minX.clear(); maxX.clear();
+    minY.clear(); maxY.clear();
+
+    for (int i = 0; i < size(); ++i)
+        pushExtremes(dropped + i, at(i));
+}
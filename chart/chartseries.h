@@ -0,0 +1,123 @@
+#ifndef CHARTSERIES_H
+#define CHARTSERIES_H
+
+#include "chartbounds.h"
+
+#include <QVector>
+#include <QPointF>
+
+#include <deque>
+#include <memory>
+
+//непрерывный выровненный массив qreal для раскладки по столбцам;
+//копии разделяют буфер до первого изменения, как у QVector
+class ChartColumn
+{
+public:
+    ChartColumn() : sz(0), cap(0) { }
+
+    int size() const { return sz; }
+    const qreal* data() const { return buf.get(); }
+
+    void append(qreal value)
+    {
+        if (sz == cap)
+            reserve(qMax(16, cap * 2));
+        else if (buf.use_count() > 1)
+            detach(cap);
+
+        buf.get()[sz++] = value;
+    }
+    void removeFirst(int count);
+    void clear();
+    void reserve(int newCapacity);
+
+private:
+    void detach(int newCapacity);
+
+    std::shared_ptr<qreal> buf;
+    int sz;
+    int cap;
+};
+
+
+//хранилище точек элемента данных: дозапись за амортизированное O(1)
+//и, при заданной емкости, кольцевой режим с вытеснением старых точек.
+//Точки доступны через базовые указатели x/y с шагом stride, поэтому
+//хранилище может ссылаться на внешние массивы вызывающего кода без копирования
+//и держать собственные точки парами (x, y) или отдельными столбцами x[] и y[]
+class ChartSeries
+{
+public:
+    enum Layout { Interleaved, Columnar };
+
+    ChartSeries();
+    ChartSeries(const ChartSeries& other);
+
+    ChartSeries& operator=(const ChartSeries& other);
+
+    void setData(const QVector<QPointF>& data);
+    void setData(QVector<QPointF>&& data);
+    void setExternal(const qreal* x_data, const qreal* y_data, int count, int stride,
+                     const std::shared_ptr<const void>& keep_alive);
+    void append(const QPointF& point);
+    void append(const QPointF* data, int count);
+    void clear();
+    void setCapacity(int newCapacity);
+    void setLayout(Layout newLayout);
+
+    int capacity() const { return cap; }
+    int size() const { return cnt; }
+    bool isEmpty() const { return cnt == 0; }
+    bool isExternal() const { return ext; }
+    Layout layout() const { return lay; }
+
+    qreal x(int index) const { return xp[index * st]; }
+    qreal y(int index) const { return yp[index * st]; }
+    QPointF at(int index) const { return QPointF(x(index), y(index)); }
+    QPointF first() const { return at(0); }
+    QPointF last() const { return at(cnt - 1); }
+
+    const qreal* xData() const { return xp; }
+    const qreal* yData() const { return yp; }
+    int stride() const { return st; }
+
+    QVector<QPointF> toVector() const;
+    ChartBounds bounds(int from, int count) const;
+    ChartBounds windowBounds() const;
+
+private:
+    struct Extremum
+    {
+        qint64 index;
+        qreal value;
+    };
+
+    int storedSize() const { return (lay == Interleaved) ? pts.size() : xs.size(); }
+    void store(QVector<QPointF>&& data);
+    void detach();
+    void updatePointers();
+    void trim();
+    void pushExtremes(qint64 index, const QPointF& point);
+    void rebuildExtremes();
+
+    Layout lay;
+    QVector<QPointF> pts;
+    ChartColumn xs, ys;
+    int head;
+    int cap;
+    qint64 dropped;
+
+    //текущее окно данных (свои точки или внешние массивы)
+    const qreal* xp;
+    const qreal* yp;
+    int st;
+    int cnt;
+    bool ext;
+    std::shared_ptr<const void> keepAlive;
+
+    //монотонные очереди экстремумов окна в кольцевом режиме
+    std::deque<Extremum> minX, maxX, minY, maxY;
+};
+
+#endif // CHARTSERIES_H
@@ -1,13 +1,20 @@
 #include "charttext.h"
 #include "chartdata.h"
 #include "chartaxis.h"
+#include "chartgeometry.h"
 #include "plainchart.h"
 
 #include <QPainter>
 
+#include <algorithm>
+
+//ширина ячейки сетки прореживания в высотах строки
+static const int declutterCellWidth = 4;
+
 ChartText::ChartText(PlainChart* chart)
     : ChartLayerItem(),
-      chart(chart)
+      chart(chart),
+      declutter(false), declutterDirty(true)
 {
     textPen = QPen(Qt::gray, 5, Qt::SolidLine);
 }
@@ -25,18 +32,20 @@ void ChartText::paint(QPainter* painter)
     painter->setWindow(oldWindow);
 }
 
-void ChartText::addText(const QVector<QPointF>& points, const QVector<QString>& strs)
+void ChartText::addText(const QVector<QPointF>& points, const QVector<QString>& strs, int priority)
 {
     Q_ASSERT(points.size() == strs.size());
 
     for (int i = 0; i < points.size(); ++i)
-        addText(points.at(i), strs.at(i));
+        addText(points.at(i), strs.at(i), priority);
 }
 
-void ChartText::addText(const QPointF& point, const QString& str)
+void ChartText::addText(const QPointF& point, const QString& str, int priority)
 {
     place.append(point);
     data.append(str);
+    this->priority.append(priority);
+    changed();
 }
 
 void ChartText::addAbsText(const QVector<QPointF>& points, const QVector<QString>& strs)
@@ -53,6 +62,44 @@ void ChartText::addAbsText(const QPointF& point, const QString& str)
     dataAbs.append(str);
 }
 
+void ChartText::clearData()
+{
+    place.clear();
+    data.clear();
+    priority.clear();
+    changed();
+}
+
+void ChartText::setTextPen(QPen newPen)
+{
+    textPen = newPen;
+    changed();
+}
+
+void ChartText::setDeclutter(bool enabled)
+{
+    if (declutter == enabled)
+        return;
+
+    declutter = enabled;
+    changed();
+}
+
+bool ChartText::DeclutterKey::operator==(const DeclutterKey& other) const
+{
+    return xStart == other.xStart && xScale == other.xScale &&
+           yStart == other.yStart && yScale == other.yScale &&
+           area == other.area && font == other.font;
+}
+
+void ChartText::changed()
+{
+    declutterDirty = true;
+
+    if (chart != NULL)
+        chart->invalidateLayers(PlainChart::TextLayer);
+}
+
 void ChartText::initPainter(QPainter* painter)
 {
     painter->resetTransform();
@@ -61,20 +108,80 @@ void ChartText::initPainter(QPainter* painter)
 
 void ChartText::paintPointsText(QPainter* painter)
 {
+    const QFont font = painter->font();
+    const QString font_key = font.key();
+
+    //QStaticText рисуется от левого верхнего угла, drawText - от базовой линии
+    const QPointF baseline(0, painter->fontMetrics().ascent());
+
     //отрисовка абсолютных точек (в пикселях)
     for (int i = 0; i < placeAbs.size(); ++i)
-        painter->drawText(placeAbs.at(i), dataAbs.at(i));
+        painter->drawStaticText(placeAbs.at(i) - baseline, *textCache.text(dataAbs.at(i), font, font_key));
 
     //отрисовка подписей к точкам (в координатах)
-    QVector<QPointF> adjustedPoints;
-    for (int i = 0; i < place.size(); ++i)
+    if (declutter)
     {
-        int x = chart->xAxs->pixelFromCoord(place[i].x());
-        int y = chart->yAxs->pixelFromCoord(place[i].y());
+        updateVisible(painter, font, font_key, baseline.y());
+
+        for (int i = 0; i < visible.size(); ++i)
+        {
+            const int index = visible.at(i);
+            painter->drawStaticText(labelPos(index) - baseline, *textCache.text(data.at(index), font, font_key));
+        }
+
+        return;
+    }
+
+    for (int i = 0; i < place.size(); ++i)
+        painter->drawStaticText(labelPos(i) - baseline, *textCache.text(data.at(i), font, font_key));
+}
+
+QPointF ChartText::labelPos(int index) const
+{
+    int x = chart->xAxs->pixelFromCoord(place[index].x());
+    int y = chart->yAxs->pixelFromCoord(place[index].y());
+
+    return QPointF(x, y);
+}
 
-        adjustedPoints.append(QPointF(x, y));
+void ChartText::updateVisible(QPainter* painter, const QFont& font, const QString& font_key, qreal ascent)
+{
+    DeclutterKey key;
+    key.xStart = chart->xAxs->start();
+    key.xScale = chart->xAxs->scale();
+    key.yStart = chart->yAxs->start();
+    key.yScale = chart->yAxs->scale();
+    key.area = painter->window();
+    key.font = font_key;
+
+    //пока диапазон осей, окно и подписи не менялись - набор видимых прежний
+    if (!declutterDirty && key == declutterKey)
+        return;
+
+    declutterKey = key;
+    declutterDirty = false;
+
+    visible.resize(0);
+
+    if (key.area.isEmpty() || place.isEmpty())
+        return;
+
+    //порядок обхода: по убыванию приоритета, при равных - по порядку добавления
+    QVector<int> order(place.size());
+    for (int i = 0; i < order.size(); ++i)
+        order[i] = i;
+
+    const QVector<int>& prio = priority;
+    std::stable_sort(order.begin(), order.end(), [&prio](int a, int b) { return prio.at(a) > prio.at(b); });
+
+    boxes.resize(place.size());
+    for (int i = 0; i < place.size(); ++i)
+    {
+        const QPointF pos = labelPos(i);
+        const QSizeF size = textCache.text(data.at(i), font, font_key)->size();
+        boxes[i] = QRectF(pos.x(), pos.y() - ascent, size.width(), size.height());
     }
 
-    for (int i = 0; i < adjustedPoints.size(); ++i)
-        painter->drawText(adjustedPoints.at(i), data.at(i));
+    const qreal cell_h = qMax(1, painter->fontMetrics().height());
+    declutterRects(boxes, order, key.area, QSizeF(cell_h * declutterCellWidth, cell_h), visible);
 }
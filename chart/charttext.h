@@ -2,6 +2,7 @@
 #define CHARTTEXT_H
 
 #include "chartlayeritem.h"
+#include "charttextcache.h"
 
 class PlainChart;
 
@@ -12,24 +13,49 @@ public:
 
     virtual void paint(QPainter* painter);
 
-    void addText(const QVector<QPointF>& points, const QVector<QString>& strs);
-    void addText(const QPointF& point, const QString& str);
+    void addText(const QVector<QPointF>& points, const QVector<QString>& strs, int priority = 0);
+    void addText(const QPointF& point, const QString& str, int priority = 0);
     void addAbsText(const QVector<QPointF>& points, const QVector<QString>& strs);
     void addAbsText(const QPointF& point, const QString& str);
-    void clearData() { place.clear(); data.clear(); }
-    void clearAbsData() { placeAbs.clear(); dataAbs.clear(); }
-    void setTextPen(QPen newPen) { textPen = newPen; }
+    void clearData();
+    void clearAbsData() { placeAbs.resize(0); dataAbs.resize(0); }
+    void setTextPen(QPen newPen);
+
+    //прореживание: перекрывающиеся подписи отбрасываются,
+    //при пересечении остается подпись с большим приоритетом (при равных - добавленная раньше)
+    void setDeclutter(bool enabled);
+    bool isDeclutter() const { return declutter; }
 
 private:
+    //то, от чего зависит набор видимых подписей
+    struct DeclutterKey
+    {
+        double xStart, xScale, yStart, yScale;
+        QRectF area;
+        QString font;
+
+        bool operator==(const DeclutterKey& other) const;
+    };
+
     void initPainter(QPainter* painter);
     void paintPointsText(QPainter* painter);
+    void updateVisible(QPainter* painter, const QFont& font, const QString& font_key, qreal ascent);
+    QPointF labelPos(int index) const;
+    void changed();
 
     PlainChart* chart;
     QVector<QPointF> place;
     QVector<QPointF> placeAbs;
     QVector<QString> data;
     QVector<QString> dataAbs;
+    QVector<int> priority;
+    ChartTextCache textCache;
     QPen textPen;
+
+    bool declutter, declutterDirty;
+    DeclutterKey declutterKey;
+    QVector<int> visible;
+    QVector<QRectF> boxes;
 };
 
 #endif // CHARTTEXT_H
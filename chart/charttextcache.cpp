@@ -0,0 +1,27 @@
+#include "charttextcache.h"
+
+#include <QTransform>
+
+
+ChartTextCache::ChartTextCache(int capacity)
+    : cache(capacity)
+{
+}
+
+const QStaticText* ChartTextCache::text(const QString& str, const QFont& font, const QString& font_key)
+{
+    const QPair<QString, QString> key(str, font_key);
+    QStaticText* result = cache.object(key);
+
+    if (result != NULL)
+        return result;
+
+    result = new QStaticText(str);
+    result->setTextFormat(Qt::PlainText);
+    result->setPerformanceHint(QStaticText::AggressiveCaching);
+    result->prepare(QTransform(), font);
+
+    cache.insert(key, result);
+
+    return result;
+}
@@ -0,0 +1,27 @@
+#ifndef CHARTTEXTCACHE_H
+#define CHARTTEXTCACHE_H
+
+#include <QCache>
+#include <QFont>
+#include <QPair>
+#include <QStaticText>
+
+//подготовленные (разложенные на глифы) надписи для повторной отрисовки;
+//ключ - строка и шрифт, при переполнении вытесняются давно не использованные
+class ChartTextCache
+{
+public:
+    explicit ChartTextCache(int capacity = 4096);
+
+    void setCapacity(int capacity) { cache.setMaxCost(capacity); }
+    void clear() { cache.clear(); }
+
+    //font_key - font.key(), вычисляется вызывающим один раз на кадр;
+    //указатель действителен до следующего вызова
+    const QStaticText* text(const QString& str, const QFont& font, const QString& font_key);
+
+private:
+    QCache<QPair<QString, QString>, QStaticText> cache;
+};
+
+#endif // CHARTTEXTCACHE_H
@@ -0,0 +1,104 @@
+#include "chartticks.h"
+
+#include <QtMath>
+
+#include <cmath>
+
+//предел числа делений на ось
+static const qint64 tickLimit = 512;
+//предел индекса деления, дальше k * step теряет точность
+static const qreal tickIndexLimit = 9007199254740992.0; // 2^53
+
+static const qreal niceMantissas[] = { 1, 2, 5 };
+static const int niceCount = 3;
+
+
+ChartTicks::ChartTicks()
+    : keyMin(0), keyMax(0), keyStep(0),
+      usedStep(0),
+      valid(false)
+{
+}
+
+qreal ChartTicks::niceStep(qreal step, qreal min_step)
+{
+    if (!(step > 0) || !qIsFinite(step))
+        return 0;
+
+    qreal base = std::pow(10.0, std::floor(std::log10(step)));
+    const qreal fraction = step / base;
+
+    //округление до ближайшего из 1, 2, 5, 10
+    int index;
+    if (fraction < 1.5)
+        index = 0;
+    else if (fraction < 3)
+        index = 1;
+    else if (fraction < 7)
+        index = 2;
+    else
+    {
+        index = 0;
+        base *= 10;
+    }
+
+    qreal result = niceMantissas[index] * base;
+
+    //шаг меньше подписи - подписи налезают друг на друга
+    for (int guard = 0; result <= min_step && guard < 3 * 308; ++guard)
+    {
+        if (++index == niceCount)
+        {
+            index = 0;
+            base *= 10;
+        }
+
+        result = niceMantissas[index] * base;
+    }
+
+    return result;
+}
+
+const QVector<qreal>& ChartTicks::ticks(qreal min, qreal max, qreal step)
+{
+    if (valid && min == keyMin && max == keyMax && step == keyStep)
+        return points;
+
+    valid = true;
+    keyMin = min;
+    keyMax = max;
+    keyStep = step;
+    usedStep = step;
+
+    points.resize(0);
+    points.append(0);
+
+    if (!(step > 0) || !qIsFinite(step) || !qIsFinite(min) || !qIsFinite(max) || min > max)
+        return points;
+
+    qreal first = std::ceil(min / step);
+    qreal last = std::floor(max / step);
+
+    //слишком мелкий шаг для диапазона - укрупняется
+    while (last - first + 1 > tickLimit && qIsFinite(usedStep))
+    {
+        usedStep = niceStep(usedStep * 2);
+        first = std::ceil(min / usedStep);
+        last = std::floor(max / usedStep);
+    }
+
+    if (!qIsFinite(usedStep) || qAbs(first) > tickIndexLimit || qAbs(last) > tickIndexLimit)
+        return points;
+
+    const qint64 k_first = first;
+    const qint64 k_last = last;
+
+    //сначала положительные по возрастанию, затем отрицательные по убыванию
+    for (qint64 k = qMax<qint64>(k_first, 1); k <= k_last; ++k)
+        points.append(k * usedStep);
+
+    for (qint64 k = qMin<qint64>(k_last, -1); k >= k_first; --k)
+        points.append(k * usedStep);
+
+    return points;
+}
@@ -0,0 +1,31 @@
+#ifndef CHARTTICKS_H
+#define CHARTTICKS_H
+
+#include <QVector>
+
+//деления оси: шаг вида {1, 2, 5} * 10^n, деления - целые кратные шага (k * step),
+//поэтому ошибка округления не накапливается; число делений ограничено
+class ChartTicks
+{
+public:
+    ChartTicks();
+
+    //ближайший к step "красивый" шаг, строго больший min_step (ширины подписи);
+    //0, если step не положителен
+    static qreal niceStep(qreal step, qreal min_step = 0);
+
+    //деления в [min, max]; первым всегда идет ноль - по нему рисуется нулевая линия.
+    //Результат кэшируется и пересчитывается только при смене диапазона или шага
+    const QVector<qreal>& ticks(qreal min, qreal max, qreal step);
+
+    //фактический шаг последнего набора (может быть укрупнен из-за ограничения)
+    qreal step() const { return usedStep; }
+
+private:
+    QVector<qreal> points;
+    qreal keyMin, keyMax, keyStep;
+    qreal usedStep;
+    bool valid;
+};
+
+#endif // CHARTTICKS_H
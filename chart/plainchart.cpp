@@ -2,12 +2,17 @@
 #include "chartlayer.h"
 #include "chartdata.h"
 #include "charttext.h"
+#include "chartrenderer.h"
+#include "chartticks.h"
+#include "chartfeed.h"
 #include "plainchart.h"
 #include "qmath.h"
 
 #include <QPainter>
 #include <QTransform>
 #include <QMouseEvent>
+#include <QWheelEvent>
+#include <QTimer>
 
 
 static inline qreal correct_ceil(qreal value, bool max)
@@ -18,44 +23,36 @@ static inline qreal correct_ceil(qreal value, bool max)
         return qFloor(value);
 }
 
-static inline qreal round_step(qreal step, qreal min_size)
+//масштаб за один шаг колеса
+static const qreal wheelZoomStep = 1.25;
+//после паузы такой длины жест считается завершенным, мс
+static const int navigationIdle = 200;
+//меньший диапазон не различим в подписях делений
+static const qreal minViewSpan = 1e-3;
+//частота кадров по умолчанию и в простое
+static const int defaultFrameRate = 60;
+static const int defaultIdleFrameRate = 4;
+//опрос буферов без ограничения частоты кадров, мс
+static const int minFeedInterval = 4;
+
+//позиция курсора без устаревших в Qt 5.15 / 6 QWheelEvent::pos() и QMouseEvent::pos()
+static inline QPoint eventPoint(const QWheelEvent* event)
 {
-    if (step > 1 && step < 10)
-        return (int)step;
-    if (step <= 1)
-        return step;
-
-    int i_step = step;
-
-    const QString s_step = QString::number(i_step);
-    const int f_pow = qPow(10, s_step.size() - 1);
-    const int s_pow = qPow(10, s_step.size() - 2);
-
-    while (true)
-    {
-        int s_num = i_step / s_pow % 10;
-
-        if (s_num < 3)
-            i_step -= s_num * s_pow;
-        else if (s_num >= 3 && s_num < 8)
-            i_step += (5 - s_num) * s_pow;
-        else
-        {
-            i_step += f_pow;
-            i_step -= s_num * s_pow;
-        }
-
-        i_step = i_step / s_pow * s_pow;
-
-        if (i_step > min_size)
-            return (qreal)i_step;
-        else if (s_num == 5 || s_num == 0)
-            i_step += 3 * s_pow;
-    }
-
-    return 0.0;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+    return event->position().toPoint();
+#else
+    return event->pos();
+#endif
 }
 
+static inline QPoint eventPoint(const QMouseEvent* event)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+    return event->position().toPoint();
+#else
+    return event->localPos().toPoint();
+#endif
+}
 
 PlainChart::PlainChart(QWidget *parent)
     : QLabel(parent),
@@ -66,7 +63,16 @@ PlainChart::PlainChart(QWidget *parent)
     axisLayer(new ChartLayer()),
     dataLayer(new ChartLayer()),
     textLayer(new ChartLayer()),
-    recalcBounds(true), recalcStep(true)
+    renderer(new ChartRenderer(this)),
+    recalcBounds(true), recalcStep(true),
+    asyncRender(false), frameDirty(true),
+    navTimer(new QTimer(this)),
+    feedTimer(new QTimer(this)),
+    replotTimer(new QTimer(this)),
+    replotFlags(0),
+    maxFps(defaultFrameRate), idleFps(defaultIdleFrameRate),
+    idle(false),
+    interactive(false), navigating(false), panning(false)
 {
     setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Ignored);
 
@@ -75,11 +81,23 @@ PlainChart::PlainChart(QWidget *parent)
     dataLayer->addLayer(data);
     textLayer->addLayer(text);
 
+    setLayerCaching(true);
     updateSizeAspects();
+
+    navTimer->setSingleShot(true);
+    navTimer->setInterval(navigationIdle);
+
+    connect(renderer, SIGNAL(frameReady()), this, SLOT(update()));
+    replotTimer->setSingleShot(true);
+
+    connect(navTimer, SIGNAL(timeout()), this, SLOT(finishNavigation()));
+    connect(feedTimer, SIGNAL(timeout()), this, SLOT(drainFeeds()));
+    connect(replotTimer, SIGNAL(timeout()), this, SLOT(performReplot()));
 }
 
 PlainChart::~PlainChart()
 {
+    delete renderer;
     clear();
     delete xAxs;
     delete yAxs;
@@ -90,21 +108,177 @@ PlainChart::~PlainChart()
     delete textLayer;
 }
 
-void PlainChart::replot()
+void PlainChart::requestReplot(int flags)
+{
+    replotFlags |= flags;
+    scheduleReplot();
+}
+
+void PlainChart::replotNow()
+{
+    replotTimer->stop();
+    replotFlags |= ReplotAll;
+    performReplot();
+}
+
+void PlainChart::setMaxFrameRate(int fps)
+{
+    maxFps = qMax(fps, 0);
+    updateFrameRate();
+}
+
+void PlainChart::setIdleFrameRate(int fps)
+{
+    idleFps = qMax(fps, 0);
+    updateFrameRate();
+}
+
+void PlainChart::setIdle(bool enabled)
+{
+    idle = enabled;
+    updateFrameRate();
+}
+
+bool PlainChart::isIdle() const
+{
+    return idle || !isVisible() || window()->isMinimized();
+}
+
+int PlainChart::frameInterval() const
+{
+    const int fps = isIdle() ? idleFps : maxFps;
+
+    return (fps > 0) ? 1000 / fps : 0;
+}
+
+bool PlainChart::isPaused() const
+{
+    return idleFps == 0 && isIdle();
+}
+
+void PlainChart::updateFrameRate()
+{
+    updateFeedTimer();
+
+    //ожидающая перерисовка переназначается по новой частоте,
+    //после простоя накопленное показывается сразу
+    replotTimer->stop();
+    scheduleReplot();
+}
+
+void PlainChart::updateFeedTimer()
+{
+    //буферы опрашиваются раз в кадр, на паузе не опрашиваются
+    if (feeds.isEmpty() || isPaused())
+    {
+        feedTimer->stop();
+        return;
+    }
+
+    const int interval = qMax(frameInterval(), minFeedInterval);
+
+    if (!feedTimer->isActive() || feedTimer->interval() != interval)
+        feedTimer->start(interval);
+}
+
+void PlainChart::scheduleReplot()
 {
+    //на паузе запросы копятся до выхода из простоя
+    if (replotFlags == 0 || replotTimer->isActive() || isPaused())
+        return;
+
+    //не раньше, чем через кадр после предыдущей перерисовки
+    const int interval = frameInterval();
+    const qint64 elapsed = lastReplot.isValid() ? lastReplot.elapsed() : interval;
+
+    replotTimer->start(qMax<qint64>(0, interval - elapsed));
+}
+
+void PlainChart::performReplot()
+{
+    const int flags = replotFlags;
+    replotFlags = 0;
+
+    if (flags == 0)
+        return;
+
+    lastReplot.start();
     setMouseTracking(true);
-    updateRanges();
+
+    //диапазоны пересчитываются один раз за кадр, сколько бы запросов ни пришло
+    if (flags & ReplotRanges)
+        updateRanges();
+
     update();
 }
 
+void PlainChart::invalidateLayers(int layers)
+{
+    if (layers & DataLayer)
+    {
+        dataLayer->invalidate();
+        frameDirty = true;
+    }
+
+    //подписи осей попадают в текстовый слой при отрисовке осей
+    if (layers & AxisLayer)
+        axisLayer->invalidate();
+
+    if (layers & (AxisLayer | TextLayer))
+        textLayer->invalidate();
+}
+
+void PlainChart::setLayerCaching(bool enabled)
+{
+    dataLayer->setCached(enabled);
+    axisLayer->setCached(enabled);
+    textLayer->setCached(enabled);
+}
+
 ChartDataItem* PlainChart::createDataItem(DataType type)
 {
     return data->createItem(type);
 }
 
-void PlainChart::addTextItem(const QPointF& point, const QString& str)
+void PlainChart::addTextItem(const QPointF& point, const QString& str, int priority)
 {
-    text->addText(point, str);
+    text->addText(point, str, priority);
+}
+
+void PlainChart::setTextDeclutter(bool enabled)
+{
+    text->setDeclutter(enabled);
+}
+
+void PlainChart::attachFeed(ChartFeed* feed, ChartDataItem* item)
+{
+    detachFeed(feed);
+    feeds.append(qMakePair(feed, item));
+    updateFeedTimer();
+}
+
+void PlainChart::detachFeed(ChartFeed* feed)
+{
+    for (int i = feeds.size() - 1; i >= 0; --i)
+        if (feeds.at(i).first == feed)
+            feeds.remove(i);
+
+    updateFeedTimer();
+}
+
+void PlainChart::drainFeeds()
+{
+    //все накопленное за кадр - одной дозаписью на элемент и одной перерисовкой
+    int taken = 0;
+
+    for (int i = 0; i < feeds.size(); ++i)
+        taken += feeds.at(i).first->drainTo(feeds.at(i).second);
+
+    if (taken > 0)
+        replot();
+
+    //частота опроса следует за частотой кадров (в простое - реже)
+    updateFeedTimer();
 }
 
 void PlainChart::setExtremes(qreal x_min, qreal x_max, qreal y_min, qreal y_max)
@@ -113,6 +287,17 @@ void PlainChart::setExtremes(qreal x_min, qreal x_max, qreal y_min, qreal y_max)
     yAxs->setRange(correct_ceil(y_min, false), correct_ceil(y_max, true));
 
     recalcBounds = false;
+    invalidateLayers();
+}
+
+void PlainChart::setView(qreal x_min, qreal x_max, qreal y_min, qreal y_max)
+{
+    xAxs->setRange(x_min, x_max);
+    yAxs->setRange(y_min, y_max);
+
+    recalcBounds = false;
+    updateRanges();
+    update();
 }
 
 void PlainChart::setGridStep(qreal step_x, qreal step_y)
@@ -121,6 +306,7 @@ void PlainChart::setGridStep(qreal step_x, qreal step_y)
     yAxs->setCell(step_y);
 
     recalcStep = false;
+    invalidateLayers(AxisLayer);
 }
 
 void PlainChart::setAngles(bool enabled)
@@ -128,12 +314,43 @@ void PlainChart::setAngles(bool enabled)
     xAxs->grid()->drawAngles(enabled);
 }
 
+void PlainChart::setAsyncRendering(bool enabled)
+{
+    asyncRender = enabled;
+    frameDirty = true;
+
+    if (!asyncRender)
+        renderer->cancel();
+
+    update();
+}
+
+void PlainChart::setTiledRendering(bool enabled)
+{
+    renderer->setTiled(enabled);
+    frameDirty = true;
+    update();
+}
+
+void PlainChart::setInteractive(bool enabled)
+{
+    interactive = enabled;
+
+    if (!interactive)
+    {
+        panning = false;
+        navTimer->stop();
+        finishNavigation();
+    }
+}
+
 void PlainChart::resetBounds()
 {
     xAxs->setRange(0, 0);
     yAxs->setRange(0, 0);
 
     recalcBounds = true;
+    invalidateLayers();
 }
 
 void PlainChart::calcChartParams(QPainter* painter)
@@ -156,8 +373,8 @@ void PlainChart::calcChartParams(QPainter* painter)
         const qreal x_step = xAxs->getSpan() / x_number_of_ticks;
         const qreal y_step = yAxs->getSpan() / y_number_of_ticks;
 
-        xAxs->setCell(round_step(x_step, coord_text_width));
-        yAxs->setCell(round_step(y_step, coord_text_height));
+        xAxs->setCell(ChartTicks::niceStep(x_step, coord_text_width));
+        yAxs->setCell(ChartTicks::niceStep(y_step, coord_text_height));
     }
 }
 
@@ -165,6 +382,11 @@ void PlainChart::clear()
 {
     setMouseTracking(false);
 
+    //буферы и загрузки ссылаются на удаляемые элементы
+    feeds.clear();
+    feedTimer->stop();
+    emit dataCleared();
+
     data->clearData();
     text->clearData();
     text->clearAbsData();
@@ -173,13 +395,27 @@ void PlainChart::clear()
     yAxs->setRange(0, 0);
     recalcBounds = true;
     recalcStep = true;
+    invalidateLayers();
 
     //    emit currentCoords(meter(0), meter(0));
 }
 
+void PlainChart::showEvent(QShowEvent* event)
+{
+    QLabel::showEvent(event);
+    updateFrameRate();
+}
+
+void PlainChart::hideEvent(QHideEvent* event)
+{
+    QLabel::hideEvent(event);
+    updateFrameRate();
+}
+
 void PlainChart::resizeEvent(QResizeEvent *)
 {
     updateSizeAspects();
+    invalidateLayers();
     update();
 }
 
@@ -192,19 +428,161 @@ void PlainChart::paintEvent(QPaintEvent *)
     painter.setRenderHints(QPainter::Antialiasing | QPainter::TextAntialiasing, true);
 
     calcChartParams(&painter);
-    text->clearAbsData();
 
-    dataLayer->paint(&painter);
+    //подписи осей пересоздаются только вместе со слоем осей
+    if (!axisLayer->isValid())
+        text->clearAbsData();
+
+    if (asyncRender || navigating)
+        paintDataFrame(&painter);
+    else
+        dataLayer->paint(&painter);
+
     axisLayer->paint(&painter);
     textLayer->paint(&painter);
 }
 
+void PlainChart::paintDataFrame(QPainter* painter)
+{
+    //новый кадр запрашивается один раз на изменение, до его готовности
+    //показывается предыдущий
+    if (frameDirty || frameSize != size())
+    {
+        renderer->render(data->cloneItems(), data->projection(), size(),
+                         devicePixelRatioF(), painter->renderHints());
+
+        frameDirty = false;
+        frameSize = size();
+    }
+
+    const QImage& frame = renderer->frame();
+
+    if (frame.isNull())
+        return;
+
+    //кадр мог быть нарисован для другого диапазона осей (новый еще не готов) -
+    //переводим его пиксели в текущие
+    const QTransform reproject = ChartData::pixelTransform(renderer->frameProjection()).inverted() *
+                                 ChartData::pixelTransform(data->projection());
+
+    if (reproject.isIdentity())
+    {
+        painter->drawImage(0, 0, frame);
+        return;
+    }
+
+    const QTransform oldTr = painter->transform();
+
+    painter->setTransform(reproject, true);
+    painter->drawImage(0, 0, frame);
+    painter->setTransform(oldTr);
+}
+
+void PlainChart::beginNavigation()
+{
+    navTimer->start();
+
+    if (navigating)
+        return;
+
+    navigating = true;
+
+    //в синхронном режиме актуальный кадр лежит в кэше слоя данных
+    if (!asyncRender)
+    {
+        renderer->cancel();
+        renderer->setFrame(dataLayer->isValid() ? dataLayer->image() : QImage(), data->projection());
+    }
+}
+
+void PlainChart::finishNavigation()
+{
+    if (panning || !navigating)
+        return;
+
+    navigating = false;
+
+    //в синхронном режиме окончательный кадр рисуется слоем данных
+    if (!asyncRender)
+        renderer->cancel();
+
+    update();
+}
+
+void PlainChart::wheelEvent(QWheelEvent* event)
+{
+    const int delta = event->angleDelta().y();
+
+    if (!interactive || data->isEmpty() || delta == 0)
+    {
+        QLabel::wheelEvent(event);
+        return;
+    }
+
+    event->accept();
+
+    //точка под курсором остается на месте
+    const qreal factor = qPow(wheelZoomStep, -delta / 120.0);
+    const QPoint pointer = eventPoint(event);
+    const qreal x = xAxs->coordFromPixel(pointer.x());
+    const qreal y = yAxs->coordFromPixel(pointer.y());
+
+    const qreal x_min = x - (x - xAxs->min()) * factor;
+    const qreal x_max = x + (xAxs->max() - x) * factor;
+    const qreal y_min = y - (y - yAxs->min()) * factor;
+    const qreal y_max = y + (yAxs->max() - y) * factor;
+
+    if (x_max - x_min < minViewSpan || y_max - y_min < minViewSpan)
+        return;
+
+    beginNavigation();
+    setView(x_min, x_max, y_min, y_max);
+}
+
+void PlainChart::mousePressEvent(QMouseEvent* event)
+{
+    if (!interactive || data->isEmpty() || event->button() != Qt::LeftButton)
+    {
+        QLabel::mousePressEvent(event);
+        return;
+    }
+
+    panning = true;
+    panOrigin = eventPoint(event);
+    panStart = ChartBounds(xAxs->min(), xAxs->max(), yAxs->min(), yAxs->max());
+
+    beginNavigation();
+}
+
+void PlainChart::mouseReleaseEvent(QMouseEvent* event)
+{
+    if (!panning || event->button() != Qt::LeftButton)
+    {
+        QLabel::mouseReleaseEvent(event);
+        return;
+    }
+
+    panning = false;
+    //окончание жеста - после паузы, чтобы фоновый кадр успел смениться
+    navTimer->start();
+}
+
 void PlainChart::mouseMoveEvent(QMouseEvent *event)
 {
     if (data->isEmpty())
         return;
 
-    const QPoint pointer = event->pos();
+    const QPoint pointer = eventPoint(event);
+
+    if (panning)
+    {
+        //сдвиг в координатах с учетом направления осей
+        const qreal dx = xAxs->coordFromPixel(pointer.x() - panOrigin.x()) - xAxs->coordFromPixel(0);
+        const qreal dy = yAxs->coordFromPixel(pointer.y() - panOrigin.y()) - yAxs->coordFromPixel(0);
+
+        navTimer->start();
+        setView(panStart.minX - dx, panStart.maxX - dx, panStart.minY - dy, panStart.maxY - dy);
+    }
 
     calcCoordsPoints(pointer);
     calcCoordsAngle(pointer);
@@ -245,18 +623,16 @@ void PlainChart::updateRanges()
 
     const int x_sign = xAxs->isInverted() ? -1 : 1;
     const int y_sign = yAxs->isInverted() ? -1 : 1;
+    const ChartProjection old_proj = data->projection();
 
     if (recalcBounds)
     {
-        const QVector<qreal>& bounds = data->range();
-
-        if (!bounds.isEmpty())
-        {
-            x_start = bounds.at(0);
-            x_finish = bounds.at(1);
-            y_start = bounds.at(2);
-            y_finish = bounds.at(3);
-        }
+        const ChartBounds& bounds = data->range();
+
+        x_start = bounds.minX;
+        x_finish = bounds.maxX;
+        y_start = bounds.minY;
+        y_finish = bounds.maxY;
     }
     else
     {
@@ -283,6 +659,11 @@ void PlainChart::updateRanges()
 
     xAxs->setShift(x_shift);
     yAxs->setShift(y_shift);
+
+    //кэш слоев сбрасывается, только если изменилось отображение осей;
+    //изменения данных и стиля сбрасывают свои слои сами
+    if (data->projection() != old_proj)
+        invalidateLayers();
 }
 
 void PlainChart::updateSizeAspects()
@@ -5,29 +5,71 @@
 #include "chartaxis.h"
 
 #include <QLabel>
+#include <QElapsedTimer>
 
+class QTimer;
 class ChartAxis;
+class ChartFeed;
 class ChartText;
 class ChartLayer;
+class ChartRenderer;
 
 class PlainChart : public QLabel
 {
     Q_OBJECT
 
 public:
+    enum Layer { DataLayer = 0x1, AxisLayer = 0x2, TextLayer = 0x4,
+                 AllLayers = DataLayer | AxisLayer | TextLayer };
+    //что нужно сделать при очередной перерисовке: пересчитать диапазоны осей
+    //(изменились данные или границы) или только перерисовать (изменился стиль)
+    enum ReplotFlag { ReplotRanges = 0x1, ReplotPaint = 0x2,
+                      ReplotAll = ReplotRanges | ReplotPaint };
+
     explicit PlainChart(QWidget *parent = 0);
     ~PlainChart();
 
-    void replot();
+    //запросы перерисовки накапливаются и выполняются не чаще раза за кадр
+    void replot() { requestReplot(ReplotAll); }
+    void requestReplot(int flags);
+    //немедленная перерисовка в обход ограничения частоты
+    void replotNow();
+    //ограничение частоты кадров; 0 - без ограничения (перерисовка сразу по запросу)
+    void setMaxFrameRate(int fps);
+    int maxFrameRate() const { return maxFps; }
+    //частота в простое: виджет скрыт или свернут, либо задан setIdle(true).
+    //0 - пауза: в простое нет ни перерисовок, ни опроса буферов
+    void setIdleFrameRate(int fps);
+    int idleFrameRate() const { return idleFps; }
+    void setIdle(bool enabled);
+    bool isIdle() const;
+    void invalidateLayers(int layers = AllLayers);
+    void setLayerCaching(bool enabled);
+    void setAsyncRendering(bool enabled);
+    bool isAsyncRendering() const { return asyncRender; }
+    void setTiledRendering(bool enabled);
+    //навигация мышью: колесо - масштаб относительно курсора, перетаскивание - сдвиг.
+    //Во время жеста показывается пересчитанный прежний кадр, новый рисуется в фоне.
+    //По умолчанию выключена
+    void setInteractive(bool enabled);
+    bool isInteractive() const { return interactive; }
 
     ChartDataItem* createDataItem(DataType type);
-    void addTextItem(const QPointF& point, const QString& str);
+    void addTextItem(const QPointF& point, const QString& str, int priority = 0);
+    void setTextDeclutter(bool enabled);
+    //точки из feed дописываются в item в потоке GUI раз в кадр;
+    //feed должен жить до detachFeed или clear() - clear() удаляет элементы
+    //и отключает все буферы
+    void attachFeed(ChartFeed* feed, ChartDataItem* item);
+    void detachFeed(ChartFeed* feed);
     void rescaleAxes() { updateRanges(); }
     void setHeightItem(ChartDataItem* item) { data->setHeightItem(item); }
 
     ChartAxis* xAxis() const { return xAxs; }
     ChartAxis* yAxis() const { return yAxs; }
     void setExtremes(qreal x_min, qreal x_max, qreal y_min, qreal y_max);
+    //как setExtremes, но без округления границ
+    void setView(qreal x_min, qreal x_max, qreal y_min, qreal y_max);
     void setGridStep(qreal step_x, qreal step_y);
     void setAngles(bool enabled);
     void resetBounds();
@@ -38,6 +80,16 @@ protected:
     void resizeEvent(QResizeEvent*);
     void paintEvent(QPaintEvent *);
     void mouseMoveEvent(QMouseEvent *event);
+    void mousePressEvent(QMouseEvent* event);
+    void mouseReleaseEvent(QMouseEvent* event);
+    void wheelEvent(QWheelEvent* event);
+    void showEvent(QShowEvent* event);
+    void hideEvent(QHideEvent* event);
+
+private slots:
+    void finishNavigation();
+    void drainFeeds();
+    void performReplot();
 
 private:
     ChartAxis* xAxs;
@@ -48,12 +100,34 @@ private:
     ChartLayer* axisLayer;
     ChartLayer* dataLayer;
     ChartLayer* textLayer;
+    ChartRenderer* renderer;
 
     int textWidth;
     int textHeight;
     bool recalcBounds, recalcStep;
+    bool asyncRender, frameDirty;
+    QSize frameSize;
+
+    QTimer* navTimer;
+    QTimer* feedTimer;
+    QTimer* replotTimer;
+    QElapsedTimer lastReplot;
+    int replotFlags;
+    int maxFps, idleFps;
+    bool idle;
+    QVector<QPair<ChartFeed*, ChartDataItem*> > feeds;
+    bool interactive, navigating, panning;
+    QPoint panOrigin;
+    ChartBounds panStart;
 
     void calcChartParams(QPainter* painter);
+    void paintDataFrame(QPainter* painter);
+    void beginNavigation();
+    int frameInterval() const;
+    bool isPaused() const;
+    void updateFrameRate();
+    void updateFeedTimer();
+    void scheduleReplot();
 
     void calcCoordsPoints(const QPoint &pointer);
     void calcCoordsAngle(const QPoint& pointer);
@@ -64,6 +138,8 @@ private:
 signals:
     void currentAngle(qreal);
     void currentCoords(qreal, qreal);
+    //элементы данных сейчас будут удалены (clear), ссылки на них нужно сбросить
+    void dataCleared();
 
     friend class ChartAxis;
     friend class ChartData;
@@ -0,0 +1,217 @@
+#include "chartdata.h"
+#include "chartkernels.h"
+#include "chartseries.h"
+
+#include <QtTest>
+
+#include <random>
+
+Q_DECLARE_METATYPE(ChartKernelLevel)
+
+
+//время на 1000 запросов; рост по строкам показывает зависимость от числа точек
+static const int lookupQueries = 1000;
+//размер набора для замеров ядер
+static const int kernelPoints = 1 << 20;
+
+static void addKernelRows()
+{
+    QTest::addColumn<ChartKernelLevel>("level");
+
+    QTest::newRow("scalar") << ScalarKernels;
+    QTest::newRow("sse2") << Sse2Kernels;
+    QTest::newRow("avx2") << Avx2Kernels;
+}
+
+static QVector<QPointF> randomPoints(int count)
+{
+    std::mt19937 random(1);
+    std::uniform_real_distribution<double> value(-1e6, 1e6);
+    QVector<QPointF> points(count);
+
+    for (int i = 0; i < count; ++i)
+        points[i] = QPointF(value(random), value(random));
+
+    return points;
+}
+
+
+class BenchChart : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void cleanup();
+
+    void routeLookup_data();
+    void routeLookup();
+
+    void bounds_data();
+    void bounds();
+    void rectCount_data();
+    void rectCount();
+
+    void seriesLayout_data();
+    void seriesLayout();
+};
+
+
+void BenchChart::cleanup()
+{
+    setKernelLevel(Avx2Kernels);
+}
+
+
+void BenchChart::routeLookup_data()
+{
+    QTest::addColumn<int>("count");
+    QTest::addColumn<bool>("sorted");
+
+    //неупорядоченный профиль ищется полным перебором - для сравнения
+    QTest::newRow("linear 1k") << 1000 << false;
+    QTest::newRow("linear 10k") << 10000 << false;
+    QTest::newRow("indexed 1k") << 1000 << true;
+    QTest::newRow("indexed 10k") << 10000 << true;
+    QTest::newRow("indexed 100k") << 100000 << true;
+    QTest::newRow("indexed 1M") << 1000000 << true;
+}
+
+void BenchChart::routeLookup()
+{
+    QFETCH(int, count);
+    QFETCH(bool, sorted);
+
+    QVector<QPointF> profile(count);
+
+    for (int i = 0; i < count; ++i)
+        profile[i] = QPointF(i, i % 100);
+
+    if (!sorted)
+        std::swap(profile[0], profile[1]);
+
+    ChartRouteData route;
+    route.setData(profile);
+    route.setInterpolation(true);
+
+    //случайные x, чтобы не срабатывала проверка соседних отрезков
+    std::mt19937 random(1);
+    std::uniform_real_distribution<double> x_value(0, count - 1);
+    QVector<qreal> queries(lookupQueries);
+
+    for (int i = 0; i < queries.size(); ++i)
+        queries[i] = x_value(random);
+
+    qreal sum = 0;
+
+    QBENCHMARK
+    {
+        for (int i = 0; i < queries.size(); ++i)
+            sum += route.heightValue(queries.at(i));
+    }
+
+    QVERIFY(sum == sum);
+}
+
+void BenchChart::bounds_data()
+{
+    addKernelRows();
+}
+
+void BenchChart::bounds()
+{
+    QFETCH(ChartKernelLevel, level);
+
+    if (level > supportedKernelLevel())
+        QSKIP("instruction set is not available");
+
+    const QVector<QPointF> points = randomPoints(kernelPoints);
+    ChartBounds result;
+
+    setKernelLevel(level);
+
+    QBENCHMARK
+    {
+        result = boundsOfPoints(points.constData(), points.size());
+    }
+
+    QVERIFY(result.minX <= result.maxX);
+}
+
+void BenchChart::rectCount_data()
+{
+    addKernelRows();
+}
+
+void BenchChart::rectCount()
+{
+    QFETCH(ChartKernelLevel, level);
+
+    if (level > supportedKernelLevel())
+        QSKIP("instruction set is not available");
+
+    const QVector<QPointF> points = randomPoints(kernelPoints);
+    QVector<qreal> xs(points.size()), ys(points.size());
+
+    for (int i = 0; i < points.size(); ++i)
+    {
+        xs[i] = points.at(i).x();
+        ys[i] = points.at(i).y();
+    }
+
+    const QRectF rect(-5e5, -5e5, 1e6, 1e6);
+    int result = 0;
+
+    setKernelLevel(level);
+
+    QBENCHMARK
+    {
+        result = countInRect(xs.constData(), ys.constData(), xs.size(), 1, rect);
+    }
+
+    QVERIFY(result > 0);
+}
+
+void BenchChart::seriesLayout_data()
+{
+    QTest::addColumn<bool>("columnar");
+    QTest::addColumn<int>("pass");
+
+    //габариты, номера столбцов и отсечение по прямоугольнику на обеих раскладках
+    QTest::newRow("interleaved bounds") << false << 0;
+    QTest::newRow("columnar bounds") << true << 0;
+    QTest::newRow("interleaved columns") << false << 1;
+    QTest::newRow("columnar columns") << true << 1;
+    QTest::newRow("interleaved cull") << false << 2;
+    QTest::newRow("columnar cull") << true << 2;
+}
+
+void BenchChart::seriesLayout()
+{
+    QFETCH(bool, columnar);
+    QFETCH(int, pass);
+
+    ChartSeries series;
+    series.setLayout(columnar ? ChartSeries::Columnar : ChartSeries::Interleaved);
+    series.setData(randomPoints(kernelPoints));
+
+    const int count = series.size();
+    const QRectF rect(-5e5, -5e5, 1e6, 1e6);
+    QVector<qreal> pixels(count);
+    qreal sum = 0;
+
+    QBENCHMARK
+    {
+        if (pass == 0)
+            sum += series.bounds(0, count).maxX;
+        else if (pass == 1)
+            pixelColumns(series.xData(), count, series.stride(), -1e6, 1e3, pixels.data());
+        else
+            sum += countInRect(series.xData(), series.yData(), count, series.stride(), rect);
+    }
+
+    QVERIFY(sum == sum);
+}
+
+QTEST_GUILESS_MAIN(BenchChart)
+
+#include "bench_chart.moc"
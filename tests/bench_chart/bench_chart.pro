@@ -0,0 +1,11 @@
+QT += testlib widgets
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+TARGET = bench_chart
+
+include(../../chart/chart.pro)
+
+SOURCES += \
+    bench_chart.cpp
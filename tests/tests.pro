@@ -0,0 +1,8 @@
+#проверки и замеры библиотеки графиков:
+#  tst_chart   - тесты (make check)
+#  bench_chart - замеры QBENCHMARK, запускаются вручную (./bench_chart)
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    tst_chart \
+    bench_chart
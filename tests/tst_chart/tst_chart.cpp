@@ -0,0 +1,2375 @@
+#include "chartaxis.h"
+#include "chartdata.h"
+#include "chartdatafile.h"
+#include "chartfeed.h"
+#include "chartgeometry.h"
+#include "chartindex.h"
+#include "chartingest.h"
+#include "chartlayer.h"
+#include "chartmarker.h"
+#include "chartpyramid.h"
+#include "chartrenderer.h"
+#include "chartseries.h"
+#include "charttextcache.h"
+#include "chartticks.h"
+#include "chartkernels.h"
+
+#include <QtTest>
+#include <QtConcurrent>
+#include <QTemporaryDir>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <random>
+
+Q_DECLARE_METATYPE(ChartKernelLevel)
+Q_DECLARE_METATYPE(ChartDataFile::Layout)
+Q_DECLARE_METATYPE(ChartDataFile::Precision)
+Q_DECLARE_METATYPE(ChartPointData::PaintMode)
+
+
+//отрезок профиля, содержащий x, полным перебором (выигрывает последний)
+static qreal referenceHeight(const QVector<QPointF>& profile, qreal x, bool interpolate)
+{
+    int segment = -1;
+
+    for (int i = 0; i < profile.size() - 1; ++i)
+    {
+        if (profile.at(i).x() <= x && profile.at(i+1).x() > x)
+            segment = i;
+    }
+
+    if (segment < 0)
+        return 0.0;
+
+    const QPointF left = profile.at(segment);
+
+    if (!interpolate)
+        return left.y();
+
+    const QPointF right = profile.at(segment + 1);
+
+    return left.y() + (right.y() - left.y()) * (x - left.x()) / (right.x() - left.x());
+}
+
+//упорядоченный по x профиль со случайным шагом и повторяющимися x
+static QVector<QPointF> sortedProfile(int count, std::mt19937& random)
+{
+    std::uniform_real_distribution<double> step(0, 2);
+    std::uniform_real_distribution<double> height(-50, 50);
+
+    QVector<QPointF> profile;
+    profile.reserve(count);
+
+    qreal x = -100;
+
+    for (int i = 0; i < count; ++i)
+    {
+        if (i % 17 != 0)
+            x += step(random);
+
+        profile.append(QPointF(x, height(random)));
+    }
+
+    return profile;
+}
+
+static bool sameValue(qreal a, qreal b)
+{
+    return a == b || (std::isnan(a) && std::isnan(b));
+}
+
+static bool sameBounds(const ChartBounds& a, const ChartBounds& b)
+{
+    return sameValue(a.minX, b.minX) && sameValue(a.maxX, b.maxX) &&
+           sameValue(a.minY, b.minY) && sameValue(a.maxY, b.maxY);
+}
+
+//габариты без NaN по каждой оси отдельно, нули - если по оси чисел нет
+static ChartBounds naiveBounds(const QVector<QPointF>& points)
+{
+    const qreal inf = std::numeric_limits<qreal>::infinity();
+    qreal min_x = inf, max_x = -inf, min_y = inf, max_y = -inf;
+
+    for (int i = 0; i < points.size(); ++i)
+    {
+        if (!std::isnan(points.at(i).x()))
+        {
+            min_x = qMin(min_x, points.at(i).x());
+            max_x = qMax(max_x, points.at(i).x());
+        }
+
+        if (!std::isnan(points.at(i).y()))
+        {
+            min_y = qMin(min_y, points.at(i).y());
+            max_y = qMax(max_y, points.at(i).y());
+        }
+    }
+
+    if (min_x > max_x)
+        min_x = max_x = 0;
+    if (min_y > max_y)
+        min_y = max_y = 0;
+
+    return ChartBounds(min_x, max_x, min_y, max_y);
+}
+
+static ChartBounds referenceBounds(const std::deque<QPointF>& points)
+{
+    if (points.empty())
+        return ChartBounds();
+
+    ChartBounds bounds(points.front().x(), points.front().x(), points.front().y(), points.front().y());
+
+    for (size_t i = 1; i < points.size(); ++i)
+        bounds.unite(ChartBounds(points[i].x(), points[i].x(), points[i].y(), points[i].y()));
+
+    return bounds;
+}
+
+//прореживание M4 полным перебором: в каждом столбце первая, последняя и первые
+//встреченные минимальная и максимальная по y точки в исходном порядке
+static QVector<QPointF> referenceColumns(const QVector<QPointF>& points, int from, int to, qreal origin, qreal unit)
+{
+    QVector<QPointF> result;
+
+    for (int first = from; first < to; )
+    {
+        const qreal column = std::floor((points.at(first).x() - origin) / unit);
+        int last = first, low = first, high = first;
+
+        while (last + 1 < to && std::floor((points.at(last + 1).x() - origin) / unit) == column)
+        {
+            ++last;
+
+            if (points.at(last).y() < points.at(low).y())
+                low = last;
+            if (points.at(last).y() > points.at(high).y())
+                high = last;
+        }
+
+        int kept[] = { first, low, high, last };
+        std::sort(kept, kept + 4);
+
+        for (int k = 0; k < 4; ++k)
+        {
+            if (k == 0 || kept[k] != kept[k - 1])
+                result.append(points.at(kept[k]));
+        }
+
+        first = last + 1;
+    }
+
+    return result;
+}
+
+//прореживание полным перебором: прямоугольник остается, если не пересекает ни одного оставленного
+static QVector<int> referenceDeclutter(const QVector<QRectF>& rects, const QVector<int>& order, const QRectF& area)
+{
+    QVector<int> result;
+
+    for (int i = 0; i < order.size(); ++i)
+    {
+        const QRectF& box = rects.at(order.at(i));
+        bool is_free = box.intersects(area);
+
+        for (int k = 0; k < result.size() && is_free; ++k)
+            is_free = !rects.at(result.at(k)).intersects(box);
+
+        if (is_free)
+            result.append(order.at(i));
+    }
+
+    return result;
+}
+
+//опорные точки блоков по size точек, пересекающихся с [from, to), полным перебором:
+//первая, последняя и первые по порядку минимум и максимум по y
+static QVector<QPointF> referenceBuckets(const QVector<QPointF>& points, int size, int from, int to)
+{
+    QVector<QPointF> result;
+
+    for (int first = from / size * size; first < to && first < points.size(); first += size)
+    {
+        const int last = qMin(first + size, points.size()) - 1;
+        int low = first, high = first;
+
+        for (int i = first; i <= last; ++i)
+        {
+            if (points.at(i).y() < points.at(low).y())
+                low = i;
+            if (points.at(i).y() > points.at(high).y())
+                high = i;
+        }
+
+        int kept[] = { first, qMin(low, high), qMax(low, high), last };
+
+        for (int k = 0; k < 4; ++k)
+        {
+            if (k == 0 || kept[k] != kept[k - 1])
+                result.append(points.at(kept[k]));
+        }
+    }
+
+    return result;
+}
+
+//пирамида совпадает с полным перебором на всех уровнях, целиком и на диапазоне
+static bool samePyramid(const ChartPyramid& pyramid, const ChartSeries& series, const QVector<QPointF>& points)
+{
+    const int count = points.size();
+    const int ranges[][2] = { { 0, count }, { count / 3, count - count / 5 }, { count - 1, count } };
+
+    for (int level = 0; level < pyramid.levelCount(); ++level)
+        for (int r = 0; r < 3; ++r)
+        {
+            const int from = ranges[r][0], to = ranges[r][1];
+
+            if (from >= to)
+                continue;
+
+            QPolygonF result;
+            pyramid.collect(series, level, from, to, result);
+
+            if (QVector<QPointF>(result) != referenceBuckets(points, pyramid.bucketSize(level), from, to))
+                return false;
+        }
+
+    return true;
+}
+
+//расстояние от точки до ближайшего ребра замкнутого контура, полным перебором
+static qreal ringDistance(const QPointF& p, const QPolygonF& ring)
+{
+    qreal result = std::numeric_limits<qreal>::max();
+
+    for (int i = 0; i < ring.size(); ++i)
+    {
+        const QPointF a = ring.at(i);
+        const QPointF b = ring.at((i + 1) % ring.size());
+        const QPointF ab = b - a, ap = p - a;
+        const qreal length2 = ab.x() * ab.x() + ab.y() * ab.y();
+        const qreal t = (length2 > 0) ? qBound<qreal>(0, (ap.x() * ab.x() + ap.y() * ab.y()) / length2, 1) : 0;
+        const QPointF d = a + ab * t - p;
+
+        result = qMin(result, std::sqrt(d.x() * d.x() + d.y() * d.y()));
+    }
+
+    return result;
+}
+
+//элемент слоя, считающий свои отрисовки
+class CountingItem : public ChartLayerItem
+{
+public:
+    CountingItem() : paints(0), color(Qt::red) { }
+
+    virtual void paint(QPainter* painter)
+    {
+        ++paints;
+        painter->fillRect(QRect(10, 10, 30, 20), color);
+    }
+
+    int paints;
+    QColor color;
+};
+
+//слой, нарисованный на прозрачном изображении size
+static QImage paintLayer(ChartLayer& layer, const QSize& size)
+{
+    QImage image(size, QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+
+    QPainter painter(&image);
+    layer.paint(&painter);
+    painter.end();
+
+    return image;
+}
+
+//сетка, нарисованная на прозрачном изображении size
+static QImage paintGrid(ChartGrid& grid, const QVector<QLineF>& lines, const QSize& size)
+{
+    QImage image(size, QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::Antialiasing, true);
+    grid.paint(&painter, lines, size.height());
+    painter.end();
+
+    return image;
+}
+
+//сетка, нарисованная как до пакетной отрисовки: каждая линия отдельным drawLine
+static QImage referenceGrid(const QVector<QLineF>& lines, const QPen& zero_pen, const QPen& grid_pen, const QSize& size)
+{
+    QImage image(size, QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::Antialiasing, true);
+
+    painter.setPen(zero_pen);
+    painter.drawLine(lines.at(0));
+
+    painter.setPen(grid_pen);
+    for (int i = 1; i < lines.size(); ++i)
+        painter.drawLine(lines.at(i));
+
+    painter.end();
+
+    return image;
+}
+
+//нулевая линия и вертикальные линии сетки с шагом step от first
+static QVector<QLineF> verticalGrid(qreal first, qreal step, const QSize& size)
+{
+    QVector<QLineF> lines;
+    lines.append(QLineF(0, size.height() / 2, size.width(), size.height() / 2));
+
+    for (qreal x = first; x < size.width(); x += step)
+        lines.append(QLineF(x, 0, x, size.height()));
+
+    return lines;
+}
+
+//проекция окна данных на size пикселей, ось y направлена вниз
+static ChartProjection frameProjection(const QRectF& window, const QSize& size)
+{
+    ChartProjection proj;
+    proj.xOffset = proj.yOffset = 0;
+    proj.xShift = window.left();
+    proj.yShift = window.top();
+    proj.xSpan = window.width();
+    proj.ySpan = window.height();
+    proj.xPixels = size.width();
+    proj.yPixels = size.height();
+    proj.xScale = proj.xSpan / proj.xPixels;
+    proj.yScale = proj.ySpan / proj.yPixels;
+    proj.xInverted = proj.yInverted = false;
+    proj.window = window;
+
+    return proj;
+}
+
+//кадр, нарисованный самими items синхронно в потоке вызова, как до фоновой отрисовки
+static QImage paintDirect(const QVector<ChartDataItem*>& items, const ChartProjection& proj, const QSize& size)
+{
+    QImage image(size, QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+
+    QPainter painter(&image);
+    ChartData::initPainter(&painter, proj);
+
+    for (int i = 0; i < items.size(); ++i)
+        ChartData::paintItem(&painter, items.at(i), proj);
+
+    painter.end();
+
+    return image;
+}
+
+//кадр рендерера из копий items, полосами или целиком
+static QImage renderFrame(const QVector<ChartDataItem*>& items, const ChartProjection& proj, const QSize& size,
+                          bool tiled)
+{
+    QVector<ChartDataItem*> copies;
+
+    for (int i = 0; i < items.size(); ++i)
+    {
+        items.at(i)->prepare();
+        copies.append(items.at(i)->clone());
+    }
+
+    ChartRenderer renderer;
+    renderer.setTiled(tiled);
+
+    QSignalSpy ready(&renderer, SIGNAL(frameReady()));
+    renderer.render(copies, proj, size, 1.0, QPainter::RenderHints());
+
+    if (!ready.wait(30000))
+        return QImage();
+
+    return renderer.frame();
+}
+
+
+class TestChart : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void cleanup();
+
+    void kernels_data();
+    void kernels();
+
+    void routeHeight_data();
+    void routeHeight();
+    void routeHeightAppend();
+
+    void niceStep_data();
+    void niceStep();
+    void niceStepProperties();
+    void ticksAreMultiples();
+
+    void seriesRing_data();
+    void seriesRing();
+    void seriesLayouts();
+
+    void parseNumber_data();
+    void parseNumber();
+    void parseNumberRandom();
+
+    void feedProducers_data();
+    void feedProducers();
+
+    void gridIndex_data();
+    void gridIndex();
+
+    void dataFileRoundTrip_data();
+    void dataFileRoundTrip();
+    void dataFileHeader_data();
+    void dataFileHeader();
+    void dataFileTruncated();
+
+    void tiledDensity_data();
+    void tiledDensity();
+    void tiledStrokes_data();
+    void tiledStrokes();
+
+    void decimateColumns_data();
+    void decimateColumns();
+
+    void dataRange();
+
+    void seriesOwnership();
+
+    void layerCache();
+
+    void asyncRender();
+
+    void markerSprites_data();
+    void markerSprites();
+
+    void routeFillCache();
+
+    void textCache();
+
+    void declutter_data();
+    void declutter();
+
+    void gridCache();
+
+    void simplifyContour_data();
+    void simplifyContour();
+    void clipContour_data();
+    void clipContour();
+
+    void pyramid_data();
+    void pyramid();
+};
+
+
+void TestChart::cleanup()
+{
+    setKernelLevel(Avx2Kernels);
+}
+
+void TestChart::kernels_data()
+{
+    QTest::addColumn<ChartKernelLevel>("level");
+    QTest::addColumn<int>("count");
+    QTest::addColumn<double>("nanRatio");
+
+    //размеры с остатками после векторных блоков по 2 и 4 точки
+    const int counts[] = { 1, 2, 3, 5, 7, 8, 9, 31, 10001 };
+    const double ratios[] = { 0.0, 0.1, 1.0 };
+    const ChartKernelLevel levels[] = { Sse2Kernels, Avx2Kernels };
+
+    for (int l = 0; l < 2; ++l)
+        for (int c = 0; c < 9; ++c)
+            for (int r = 0; r < 3; ++r)
+            {
+                const QByteArray tag = QByteArray(l == 0 ? "sse2 " : "avx2 ") + QByteArray::number(counts[c]) +
+                                       " nan " + QByteArray::number(ratios[r]);
+
+                QTest::newRow(tag.constData()) << levels[l] << counts[c] << ratios[r];
+            }
+}
+
+void TestChart::kernels()
+{
+    QFETCH(ChartKernelLevel, level);
+    QFETCH(int, count);
+    QFETCH(double, nanRatio);
+
+    if (level > supportedKernelLevel())
+        QSKIP("instruction set is not available");
+
+    const qreal nan = std::numeric_limits<qreal>::quiet_NaN();
+
+    std::mt19937 random(count);
+    std::uniform_real_distribution<double> value(-1e6, 1e6);
+    std::uniform_real_distribution<double> chance(0, 1);
+
+    //NaN попадают в x и y независимо
+    QVector<QPointF> points(count);
+
+    for (int i = 0; i < count; ++i)
+        points[i] = QPointF(chance(random) < nanRatio ? nan : value(random),
+                            chance(random) < nanRatio ? nan : value(random));
+
+    QVector<qreal> xs(count), ys(count), strided(3 * count);
+
+    for (int i = 0; i < count; ++i)
+    {
+        xs[i] = strided[3 * i] = points.at(i).x();
+        ys[i] = strided[3 * i + 1] = points.at(i).y();
+    }
+
+    const QRectF rect(-3e5, -5e5, 8e5, 7e5);
+    const qreal origin = -1e6, unit = 1234.5;
+
+    //скалярная ветка
+    setKernelLevel(ScalarKernels);
+
+    const ChartBounds scalar_points = boundsOfPoints(points.constData(), count);
+    const ChartBounds scalar_columns = boundsOfArrays(xs.constData(), ys.constData(), count, 1);
+    const int scalar_count = countInRect(xs.constData(), ys.constData(), count, 1, rect);
+    QVector<qreal> scalar_pixels(count);
+    pixelColumns(xs.constData(), count, 1, origin, unit, scalar_pixels.data());
+
+    QVERIFY(sameBounds(scalar_points, naiveBounds(points)));
+    QVERIFY(sameBounds(scalar_columns, scalar_points));
+
+    //векторная ветка должна совпадать побитно
+    setKernelLevel(level);
+    QCOMPARE(kernelLevel(), level);
+
+    QVERIFY(sameBounds(boundsOfPoints(points.constData(), count), scalar_points));
+    QVERIFY(sameBounds(boundsOfArrays(xs.constData(), ys.constData(), count, 1), scalar_points));
+    const qreal* pairs = reinterpret_cast<const qreal*>(points.constData());
+
+    QVERIFY(sameBounds(boundsOfArrays(pairs, pairs + 1, count, 2), scalar_points));
+    QVERIFY(sameBounds(boundsOfArrays(strided.constData(), strided.constData() + 1, count, 3), scalar_points));
+    QCOMPARE(countInRect(xs.constData(), ys.constData(), count, 1, rect), scalar_count);
+    QCOMPARE(countInRect(strided.constData(), strided.constData() + 1, count, 3, rect), scalar_count);
+
+    QVector<qreal> pixels(count);
+    pixelColumns(xs.constData(), count, 1, origin, unit, pixels.data());
+
+    for (int i = 0; i < count; ++i)
+        QVERIFY(sameValue(pixels.at(i), scalar_pixels.at(i)));
+}
+
+void TestChart::routeHeight_data()
+{
+    QTest::addColumn<bool>("sorted");
+    QTest::addColumn<bool>("interpolate");
+
+    QTest::newRow("sorted") << true << false;
+    QTest::newRow("sorted interpolated") << true << true;
+    QTest::newRow("unsorted") << false << false;
+    QTest::newRow("unsorted interpolated") << false << true;
+}
+
+void TestChart::routeHeight()
+{
+    QFETCH(bool, sorted);
+    QFETCH(bool, interpolate);
+
+    std::mt19937 random(2);
+    QVector<QPointF> profile = sortedProfile(2000, random);
+
+    //перестановка соседних точек ломает порядок и включает полный перебор
+    if (!sorted)
+        std::swap(profile[500], profile[501]);
+
+    ChartRouteData route;
+    route.setData(profile);
+    route.setInterpolation(interpolate);
+
+    std::uniform_real_distribution<double> far(profile.first().x() - 10, profile.last().x() + 10);
+    std::uniform_real_distribution<double> near(-1, 1);
+    qreal x = 0;
+
+    //вперемешку случайные точки, движение курсора и узлы профиля
+    for (int i = 0; i < 5000; ++i)
+    {
+        if (i % 3 == 0)
+            x = far(random);
+        else if (i % 3 == 1)
+            x += near(random);
+        else
+            x = profile.at(random() % profile.size()).x();
+
+        QCOMPARE(route.heightValue(x), referenceHeight(profile, x, interpolate));
+    }
+}
+
+void TestChart::routeHeightAppend()
+{
+    std::mt19937 random(3);
+    const QVector<QPointF> profile = sortedProfile(3000, random);
+
+    ChartRouteData route;
+    route.setInterpolation(true);
+
+    //запомненный отрезок не должен мешать поиску после дозаписи
+    QVector<QPointF> loaded;
+
+    for (int first = 0; first < profile.size(); first += 250)
+    {
+        const QVector<QPointF> part = profile.mid(first, 250);
+
+        route.appendData(part);
+        loaded += part;
+
+        for (int i = 0; i < 200; ++i)
+        {
+            const qreal x = loaded.first().x() + (loaded.last().x() - loaded.first().x()) * i / 199;
+
+            QCOMPARE(route.heightValue(x), referenceHeight(loaded, x, true));
+        }
+    }
+}
+
+void TestChart::niceStep_data()
+{
+    QTest::addColumn<qreal>("step");
+    QTest::addColumn<qreal>("minStep");
+    QTest::addColumn<qreal>("expected");
+
+    QTest::newRow("1") << 1.0 << 0.0 << 1.0;
+    QTest::newRow("1.4") << 1.4 << 0.0 << 1.0;
+    QTest::newRow("1.6") << 1.6 << 0.0 << 2.0;
+    QTest::newRow("3.5") << 3.5 << 0.0 << 5.0;
+    QTest::newRow("7.5") << 7.5 << 0.0 << 10.0;
+    QTest::newRow("0.025") << 0.025 << 0.0 << 0.02;
+    QTest::newRow("4000") << 4000.0 << 0.0 << 5000.0;
+    QTest::newRow("label wider") << 1.0 << 3.0 << 5.0;
+    QTest::newRow("label equal") << 2.0 << 2.0 << 5.0;
+    QTest::newRow("zero") << 0.0 << 0.0 << 0.0;
+    QTest::newRow("negative") << -1.0 << 0.0 << 0.0;
+}
+
+void TestChart::niceStep()
+{
+    QFETCH(qreal, step);
+    QFETCH(qreal, minStep);
+    QFETCH(qreal, expected);
+
+    QCOMPARE(ChartTicks::niceStep(step, minStep), expected);
+}
+
+void TestChart::niceStepProperties()
+{
+    std::mt19937 random(4);
+    std::uniform_real_distribution<double> exponent(-12, 12);
+    std::uniform_real_distribution<double> ratio(0, 3);
+
+    for (int i = 0; i < 10000; ++i)
+    {
+        const qreal step = std::pow(10.0, exponent(random));
+        const qreal min_step = step * ratio(random);
+        const qreal result = ChartTicks::niceStep(step, min_step);
+
+        //шаг строго больше подписи и имеет вид {1, 2, 5} * 10^n
+        QVERIFY(result > min_step);
+
+        const qreal mantissa = result / std::pow(10.0, std::floor(std::log10(result) + 1e-9));
+
+        QVERIFY(qAbs(mantissa - 1) < 1e-9 || qAbs(mantissa - 2) < 1e-9 || qAbs(mantissa - 5) < 1e-9);
+    }
+}
+
+void TestChart::ticksAreMultiples()
+{
+    ChartTicks ticks;
+    const QVector<qreal> points = ticks.ticks(-3.7, 12.2, 0.1);
+
+    //ноль первым, остальные - целые кратные шага внутри диапазона
+    QVERIFY(!points.isEmpty());
+    QCOMPARE(points.first(), 0.0);
+
+    for (int i = 1; i < points.size(); ++i)
+    {
+        const qreal k = points.at(i) / ticks.step();
+
+        QCOMPARE(points.at(i), std::round(k) * ticks.step());
+        QVERIFY(points.at(i) >= -3.7 && points.at(i) <= 12.2);
+    }
+
+    //слишком мелкий шаг укрупняется до предела числа делений
+    QVERIFY(ticks.ticks(0, 1e6, 1e-3).size() <= 513);
+}
+
+void TestChart::seriesRing_data()
+{
+    QTest::addColumn<bool>("columnar");
+
+    QTest::newRow("interleaved") << false;
+    QTest::newRow("columnar") << true;
+}
+
+void TestChart::seriesRing()
+{
+    QFETCH(bool, columnar);
+
+    static const int capacity = 1000;
+
+    std::mt19937 random(5);
+    std::uniform_real_distribution<double> value(-1000, 1000);
+    std::uniform_int_distribution<int> batch(1, 700);
+
+    ChartSeries series;
+    series.setLayout(columnar ? ChartSeries::Columnar : ChartSeries::Interleaved);
+    series.setCapacity(capacity);
+
+    std::deque<QPointF> model;
+
+    //много оборотов кольца, чтобы хранилище успело несколько раз уплотниться
+    for (int round = 0; round < 200; ++round)
+    {
+        QVector<QPointF> points(batch(random));
+
+        for (int i = 0; i < points.size(); ++i)
+            points[i] = QPointF(value(random), value(random));
+
+        if (round % 2 == 0)
+            series.append(points.constData(), points.size());
+        else
+            for (int i = 0; i < points.size(); ++i)
+                series.append(points.at(i));
+
+        model.insert(model.end(), points.begin(), points.end());
+
+        while ((int)model.size() > capacity)
+            model.pop_front();
+
+        QCOMPARE(series.size(), (int)model.size());
+
+        for (int i = 0; i < series.size(); ++i)
+            QCOMPARE(series.at(i), model[i]);
+
+        const ChartBounds expected = referenceBounds(model);
+        const ChartBounds bounds = series.windowBounds();
+
+        QCOMPARE(bounds.minX, expected.minX);
+        QCOMPARE(bounds.maxX, expected.maxX);
+        QCOMPARE(bounds.minY, expected.minY);
+        QCOMPARE(bounds.maxY, expected.maxY);
+    }
+
+    //уменьшение емкости оставляет последние точки
+    series.setCapacity(100);
+
+    QCOMPARE(series.size(), 100);
+    QCOMPARE(series.first(), model[model.size() - 100]);
+    QCOMPARE(series.last(), model.back());
+}
+
+void TestChart::seriesLayouts()
+{
+    static const int count = 5001;
+
+    const qreal nan = std::numeric_limits<qreal>::quiet_NaN();
+
+    std::mt19937 random(7);
+    std::uniform_real_distribution<double> value(-1e4, 1e4);
+
+    QVector<QPointF> points(count);
+
+    for (int i = 0; i < count; ++i)
+        points[i] = QPointF(i % 97 == 0 ? nan : value(random), value(random));
+
+    ChartSeries interleaved, columnar;
+    interleaved.setData(points);
+    columnar.setLayout(ChartSeries::Columnar);
+    columnar.setData(points);
+
+    QCOMPARE(interleaved.stride(), 2);
+    QCOMPARE(columnar.stride(), 1);
+    QCOMPARE(columnar.toVector().size(), count);
+
+    for (int i = 0; i < count; ++i)
+    {
+        QVERIFY(sameValue(columnar.x(i), interleaved.x(i)));
+        QVERIFY(sameValue(columnar.y(i), interleaved.y(i)));
+    }
+
+    //ядра на обеих раскладках дают одно и то же
+    QVERIFY(sameBounds(columnar.bounds(0, count), interleaved.bounds(0, count)));
+    QVERIFY(sameBounds(columnar.bounds(100, 1234), interleaved.bounds(100, 1234)));
+    QVERIFY(sameBounds(columnar.windowBounds(), interleaved.windowBounds()));
+
+    const QRectF rect(-5e3, -2e3, 8e3, 9e3);
+
+    QCOMPARE(countInRect(columnar.xData(), columnar.yData(), count, columnar.stride(), rect),
+             countInRect(interleaved.xData(), interleaved.yData(), count, interleaved.stride(), rect));
+
+    QVector<qreal> interleaved_pixels(count), columnar_pixels(count);
+    pixelColumns(interleaved.xData(), count, interleaved.stride(), -1e4, 3.5, interleaved_pixels.data());
+    pixelColumns(columnar.xData(), count, columnar.stride(), -1e4, 3.5, columnar_pixels.data());
+
+    for (int i = 0; i < count; ++i)
+        QVERIFY(sameValue(columnar_pixels.at(i), interleaved_pixels.at(i)));
+
+    //смена раскладки заполненного ряда сохраняет точки
+    interleaved.setLayout(ChartSeries::Columnar);
+    QCOMPARE(interleaved.stride(), 1);
+
+    for (int i = 0; i < count; ++i)
+        QVERIFY(sameValue(interleaved.x(i), points.at(i).x()));
+}
+
+void TestChart::parseNumber_data()
+{
+    QTest::addColumn<QByteArray>("text");
+    QTest::addColumn<bool>("valid");
+    QTest::addColumn<int>("length");
+
+    //быстрый путь
+    QTest::newRow("integer") << QByteArray("12345") << true << 5;
+    QTest::newRow("negative") << QByteArray("-0.5") << true << 4;
+    QTest::newRow("plus") << QByteArray("+7.25") << true << 5;
+    QTest::newRow("no integer part") << QByteArray(".125") << true << 4;
+    QTest::newRow("no fraction") << QByteArray("3.") << true << 2;
+    QTest::newRow("leading zeros") << QByteArray("0000.0001") << true << 9;
+    QTest::newRow("exponent") << QByteArray("1.5e10") << true << 6;
+    QTest::newRow("negative exponent") << QByteArray("-2.5E-7") << true << 7;
+    QTest::newRow("15 digits") << QByteArray("123456789012345") << true << 15;
+    QTest::newRow("negative zero") << QByteArray("-0") << true << 2;
+    //медленный путь
+    QTest::newRow("16 digits") << QByteArray("1234567890123456") << true << 16;
+    QTest::newRow("long mantissa") << QByteArray("3.14159265358979323846264338") << true << 28;
+    QTest::newRow("long integer") << QByteArray("123456789012345678901234567890") << true << 30;
+    QTest::newRow("large exponent") << QByteArray("1e300") << true << 5;
+    QTest::newRow("small exponent") << QByteArray("-1e-300") << true << 7;
+    QTest::newRow("denormal") << QByteArray("4.9e-324") << true << 8;
+    QTest::newRow("max") << QByteArray("1.7976931348623157e308") << true << 22;
+    //число кончается перед неполным порядком или разделителем
+    QTest::newRow("bare exponent") << QByteArray("2e") << true << 1;
+    QTest::newRow("signed bare exponent") << QByteArray("2e-;") << true << 1;
+    QTest::newRow("separator") << QByteArray("1.5,2") << true << 3;
+    //не числа
+    QTest::newRow("empty") << QByteArray() << false << 0;
+    QTest::newRow("sign") << QByteArray("-") << false << 0;
+    QTest::newRow("dot") << QByteArray(".") << false << 0;
+    QTest::newRow("exponent only") << QByteArray("e5") << false << 0;
+    QTest::newRow("word") << QByteArray("time") << false << 0;
+}
+
+void TestChart::parseNumber()
+{
+    QFETCH(QByteArray, text);
+    QFETCH(bool, valid);
+    QFETCH(int, length);
+
+    const char* begin = text.constData();
+    const char* p = begin;
+    double value = 0;
+
+    QCOMPARE(ChartIngest::parseNumber(p, begin + text.size(), value), valid);
+    QCOMPARE((int)(p - begin), length);
+
+    if (valid)
+    {
+        bool ok = false;
+        const double expected = text.left(length).toDouble(&ok);
+
+        QVERIFY(ok);
+        QVERIFY(sameValue(value, expected));
+        QCOMPARE(std::signbit(value), std::signbit(expected));
+    }
+}
+
+void TestChart::parseNumberRandom()
+{
+    std::mt19937 random(11);
+    std::uniform_real_distribution<double> mantissa(-1, 1);
+    std::uniform_int_distribution<int> exponent(-40, 40);
+    std::uniform_int_distribution<int> precision(1, 20);
+
+    //разные формы записи, чтобы попадать и в быстрый, и в медленный путь
+    const char* formats[] = { "%.*g", "%.*e", "%.*f", "%+.*E" };
+
+    for (int i = 0; i < 20000; ++i)
+    {
+        const double number = mantissa(random) * std::pow(10.0, exponent(random));
+        char text[512];
+        const int length = std::snprintf(text, sizeof(text), formats[i % 4], precision(random), number);
+
+        const char* p = text;
+        double value = 0;
+        bool ok = false;
+
+        QVERIFY(ChartIngest::parseNumber(p, text + length, value));
+        QCOMPARE((int)(p - text), length);
+        QVERIFY(sameValue(value, QByteArray(text, length).toDouble(&ok)));
+        QVERIFY(ok);
+    }
+}
+
+void TestChart::feedProducers_data()
+{
+    QTest::addColumn<bool>("multi");
+    QTest::addColumn<int>("producers");
+    QTest::addColumn<int>("capacity");
+
+    //маленький буфер постоянно переполняется и оборачивается
+    QTest::newRow("single") << false << 1 << 1024;
+    QTest::newRow("single small") << false << 1 << 16;
+    QTest::newRow("multi") << true << 4 << 1024;
+    QTest::newRow("multi small") << true << 4 << 16;
+}
+
+void TestChart::feedProducers()
+{
+    QFETCH(bool, multi);
+    QFETCH(int, producers);
+    QFETCH(int, capacity);
+
+    static const int perProducer = 100000;
+
+    ChartFeed feed(capacity, multi ? ChartFeed::MultiProducer : ChartFeed::SingleProducer);
+    QCOMPARE(feed.capacity(), capacity);
+
+    //производитель p пишет точки (p, 0..perProducer-1); отвергнутую точку повторяет,
+    //отказы считаются для сверки с droppedCount()
+    QAtomicInt rejected(0), stop(0);
+    QThreadPool pool;
+    pool.setMaxThreadCount(producers);
+
+    QVector<QFuture<void> > futures;
+
+    for (int p = 0; p < producers; ++p)
+        futures.append(QtConcurrent::run(&pool, [&feed, &rejected, &stop, p]()
+        {
+            for (int i = 0; i < perProducer && stop.loadAcquire() == 0; ++i)
+                while (!feed.push(QPointF(p, i)) && stop.loadAcquire() == 0)
+                {
+                    rejected.fetchAndAddRelaxed(1);
+                    QThread::yieldCurrentThread();
+                }
+        }));
+
+    //каждая точка приходит ровно один раз и по порядку своего производителя
+    QVector<int> next(producers, 0);
+    QVector<QPointF> result;
+    int total = 0;
+    bool valid = true;
+
+    for (int round = 0; valid && total < producers * perProducer; ++round)
+    {
+        const int limit = (round % 3 == 0) ? 5 : -1;
+
+        result.resize(0);
+        const int taken = feed.drain(result, limit);
+
+        valid = (taken == result.size()) && (taken <= ((limit < 0) ? feed.capacity() : limit));
+
+        for (int i = 0; valid && i < taken; ++i)
+        {
+            const int p = (int)result.at(i).x();
+
+            valid = (p >= 0 && p < producers && (int)result.at(i).y() == next.at(p));
+
+            if (valid)
+                ++next[p];
+        }
+
+        total += taken;
+
+        //читатель не отнимает процессор у производителей
+        if (taken == 0)
+            QThread::yieldCurrentThread();
+    }
+
+    //при ошибке производители останавливаются до выхода из теста
+    if (!valid)
+        stop.storeRelease(1);
+
+    for (int i = 0; i < futures.size(); ++i)
+        futures[i].waitForFinished();
+
+    QVERIFY(valid);
+
+    for (int p = 0; p < producers; ++p)
+        QCOMPARE(next.at(p), perProducer);
+
+    QCOMPARE(feed.droppedCount(), rejected.loadAcquire());
+
+    result.resize(0);
+    QCOMPARE(feed.drain(result), 0);
+}
+
+void TestChart::gridIndex_data()
+{
+    QTest::addColumn<qreal>("areaScale");
+    QTest::addColumn<bool>("nans");
+    QTest::addColumn<bool>("integral");
+
+    //габариты сетки из подсказки могут быть уже или шире точек
+    QTest::newRow("exact") << 1.0 << false << false;
+    QTest::newRow("hint narrower") << 0.5 << false << false;
+    QTest::newRow("hint wider") << 2.0 << false << false;
+    QTest::newRow("nan") << 1.0 << true << false;
+    //точки и края прямоугольников на границах ячеек
+    QTest::newRow("integral") << 1.0 << false << true;
+    QTest::newRow("integral hint narrower") << 0.5 << false << true;
+}
+
+void TestChart::gridIndex()
+{
+    QFETCH(qreal, areaScale);
+    QFETCH(bool, nans);
+    QFETCH(bool, integral);
+
+    static const int count = 20000;
+
+    const qreal nan = std::numeric_limits<qreal>::quiet_NaN();
+
+    std::mt19937 random(8);
+    std::uniform_real_distribution<double> value(-100, 100);
+    std::uniform_real_distribution<double> size(0, 150);
+
+    std::shared_ptr<QVector<qreal> > xs = std::make_shared<QVector<qreal> >(count);
+    std::shared_ptr<QVector<qreal> > ys = std::make_shared<QVector<qreal> >(count);
+
+    for (int i = 0; i < count; ++i)
+    {
+        (*xs)[i] = integral ? std::round(value(random)) : value(random);
+        (*ys)[i] = integral ? std::round(value(random)) : value(random);
+
+        if (nans && i % 13 == 0)
+            (*xs)[i] = nan;
+    }
+
+    ChartSeries series;
+    series.setExternal(xs->constData(), ys->constData(), count, 1, std::shared_ptr<const void>());
+
+    const ChartBounds area(-100 * areaScale, 100 * areaScale, -100 * areaScale, 100 * areaScale);
+    ChartGridIndex index;
+    index.build(series, area);
+
+    //те же точки через элемент с подсказкой габаритов
+    ChartDataHints hints;
+    hints.hasBounds = true;
+    hints.bounds = area;
+
+    ChartPointData item;
+    item.setExternalData(xs->constData(), ys->constData(), count, 1, xs, hints);
+
+    //малый набор индекс не строит и перебирает точки
+    static const int smallCount = 1000;
+    ChartPointData small;
+    small.setExternalData(xs->constData(), ys->constData(), smallCount, 1, xs);
+
+    QVector<int> found;
+
+    for (int k = 0; k < 500; ++k)
+    {
+        qreal left = value(random), top = value(random);
+        qreal width = size(random), height = size(random);
+
+        if (integral)
+        {
+            left = std::round(left);
+            top = std::round(top);
+            width = std::round(width);
+            height = std::round(height);
+        }
+
+        //прямоугольник нулевой ширины и целиком вне данных
+        if (k % 50 == 1)
+            width = 0;
+        if (k % 50 == 2)
+            left = 1000;
+
+        const QRectF rect(left, top, width, height);
+        QVector<int> expected;
+
+        for (int i = 0; i < count; ++i)
+        {
+            const qreal x = xs->at(i), y = ys->at(i);
+
+            if (x >= rect.left() && x <= rect.right() && y >= rect.top() && y <= rect.bottom())
+                expected.append(i);
+        }
+
+        QCOMPARE(index.count(series, rect), expected.size());
+
+        index.query(series, rect, found);
+        std::sort(found.begin(), found.end());
+        QVERIFY(found == expected);
+
+        QCOMPARE(item.countInRect(rect), expected.size());
+        QCOMPARE(item.pointsInRect(rect).size(), expected.size());
+
+        const int small_expected = std::lower_bound(expected.begin(), expected.end(), smallCount) - expected.begin();
+
+        QCOMPARE(small.countInRect(rect), small_expected);
+        QCOMPARE(small.pointsInRect(rect).size(), small_expected);
+    }
+}
+
+void TestChart::dataFileRoundTrip_data()
+{
+    QTest::addColumn<ChartDataFile::Layout>("layout");
+    QTest::addColumn<ChartDataFile::Precision>("precision");
+    QTest::addColumn<int>("count");
+    QTest::addColumn<bool>("sorted");
+
+    const ChartDataFile::Layout layouts[] = { ChartDataFile::Interleaved, ChartDataFile::Columnar };
+    const ChartDataFile::Precision precisions[] = { ChartDataFile::Double, ChartDataFile::Float };
+    //пустой файл, одна точка, неполный блок записи и набор с фоновым индексом
+    const int counts[] = { 0, 1, 5001, 100000 };
+
+    for (int l = 0; l < 2; ++l)
+        for (int p = 0; p < 2; ++p)
+            for (int c = 0; c < 4; ++c)
+                for (int s = 0; s < 2; ++s)
+                {
+                    const QByteArray tag = QByteArray(l == 0 ? "pairs " : "columns ") +
+                                           (p == 0 ? "double " : "float ") + QByteArray::number(counts[c]) +
+                                           (s == 0 ? "" : " sorted");
+
+                    QTest::newRow(tag.constData()) << layouts[l] << precisions[p] << counts[c] << (s == 1);
+                }
+}
+
+void TestChart::dataFileRoundTrip()
+{
+    QFETCH(ChartDataFile::Layout, layout);
+    QFETCH(ChartDataFile::Precision, precision);
+    QFETCH(int, count);
+    QFETCH(bool, sorted);
+
+    std::mt19937 random(count);
+    std::uniform_real_distribution<double> value(-1e3, 1e3);
+
+    QVector<QPointF> points(count);
+
+    for (int i = 0; i < count; ++i)
+        points[i] = QPointF(sorted ? i * 0.1 : value(random), value(random));
+
+    //одна перестановка делает набор неупорядоченным
+    if (!sorted && count > 1 && points.at(0).x() <= points.at(1).x())
+        std::swap(points[0], points[1]);
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString path = dir.path() + QStringLiteral("/points.bin");
+
+    QString error;
+    QVERIFY(ChartDataFile::save(path, points, layout, precision, &error));
+
+    std::shared_ptr<ChartDataFile> file = ChartDataFile::open(path, &error);
+    QVERIFY(file != NULL);
+
+    QCOMPARE(file->count(), count);
+    QCOMPARE(file->layout(), layout);
+    QCOMPARE(file->precision(), precision);
+    QCOMPARE(file->hints().sortedByX, sorted || count < 2);
+    QCOMPARE(file->hints().hasBounds, count > 0);
+
+    //значения float сравниваются с округленными при записи; округление идет через
+    //массивы float, иначе gcc 12 при -O2 сворачивает пару преобразований double-float-double
+    QVector<QPointF> expected = points;
+
+    if (precision == ChartDataFile::Float)
+    {
+        QVector<float> xs(count), ys(count);
+
+        for (int i = 0; i < count; ++i)
+        {
+            xs[i] = points.at(i).x();
+            ys[i] = points.at(i).y();
+        }
+
+        for (int i = 0; i < count; ++i)
+            expected[i] = QPointF(xs.at(i), ys.at(i));
+    }
+
+    for (int i = 0; i < count; ++i)
+    {
+        QVERIFY(file->xData()[i * file->stride()] == expected.at(i).x());
+        QVERIFY(file->yData()[i * file->stride()] == expected.at(i).y());
+    }
+
+    //габариты заголовка совпадают с записанными значениями
+    if (count > 0)
+        QVERIFY(sameBounds(file->hints().bounds, naiveBounds(expected)));
+
+    //подключение к элементу, в котором уже были точки
+    ChartPointData item;
+    item.setData(QVector<QPointF>() << QPointF(5000, 5000));
+    file->attach(&item);
+
+    QCOMPARE(item.isEmpty(), count == 0);
+
+    if (count == 0)
+        return;
+
+    QVERIFY(sameBounds(item.range(), file->hints().bounds));
+    QCOMPARE(item.countInRect(QRectF(-1e4, -1e4, 2e4, 2e4)), count);
+
+    const QRectF part(-100, -300, 400, 500);
+    int inside = 0;
+
+    for (int i = 0; i < count; ++i)
+        inside += part.contains(expected.at(i)) ? 1 : 0;
+
+    QCOMPARE(item.countInRect(part), inside);
+
+    //элемент удерживает файл после освобождения последней внешней ссылки
+    const std::weak_ptr<ChartDataFile> alive = file;
+    file.reset();
+
+    QVERIFY(!alive.expired());
+    QCOMPARE(item.countInRect(part), inside);
+
+    //фоновое построение индекса тоже держит копию серии до своего завершения
+    item.clearData();
+    QThreadPool::globalInstance()->waitForDone();
+    QVERIFY(alive.expired());
+}
+
+void TestChart::dataFileHeader_data()
+{
+    QTest::addColumn<int>("field");
+    QTest::addColumn<qint64>("value");
+    QTest::addColumn<int>("size");
+
+    //поле заголовка (смещение, 4 или 8 байт) и подставляемое значение; size - размер поля
+    QTest::newRow("valid") << -1 << qint64(0) << 0;
+    QTest::newRow("magic") << 0 << qint64(0x5354504d) << 4;
+    QTest::newRow("version") << 8 << qint64(2) << 4;
+    QTest::newRow("count too large") << 16 << qint64(11) << 8;
+    QTest::newRow("count above int") << 16 << qint64(1) << -1;
+    QTest::newRow("offset inside header") << 24 << qint64(32) << 8;
+    QTest::newRow("offset unaligned") << 24 << qint64(68) << 8;
+    QTest::newRow("offset past end") << 24 << qint64(1 << 20) << 8;
+}
+
+void TestChart::dataFileHeader()
+{
+    QFETCH(int, field);
+    QFETCH(qint64, value);
+    QFETCH(int, size);
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString path = dir.path() + QStringLiteral("/points.bin");
+
+    QVector<QPointF> points;
+
+    for (int i = 0; i < 10; ++i)
+        points.append(QPointF(i, -i));
+
+    QVERIFY(ChartDataFile::save(path, points));
+
+    QFile raw(path);
+    QVERIFY(raw.open(QIODevice::ReadOnly));
+    QByteArray bytes = raw.readAll();
+    raw.close();
+
+    QCOMPARE(bytes.size(), ChartDataFile::headerSize() + 10 * 2 * (int)sizeof(double));
+
+    if (size == 4)
+    {
+        const quint32 field_value = value;
+        memcpy(bytes.data() + field, &field_value, 4);
+    }
+    else if (size == 8)
+        memcpy(bytes.data() + field, &value, 8);
+    else if (size < 0)
+    {
+        //число точек больше int при достаточном размере файла не проверить, поэтому
+        //старшие биты ставятся в заголовке, а размер файла передается заведомо большим
+        const quint64 huge = (quint64)std::numeric_limits<int>::max() + 1;
+        memcpy(bytes.data() + 16, &huge, 8);
+    }
+
+    ChartDataFile::Header header;
+    const qint64 file_size = (size < 0) ? std::numeric_limits<qint64>::max() : bytes.size();
+    const bool valid = (field < 0);
+
+    QCOMPARE(ChartDataFile::readHeader(reinterpret_cast<const uchar*>(bytes.constData()), file_size, header), valid);
+
+    if (valid)
+    {
+        QCOMPARE(header.count, 10);
+        QCOMPARE(header.layout, ChartDataFile::Interleaved);
+        QCOMPARE(header.precision, ChartDataFile::Double);
+        QCOMPARE((int)header.offset, ChartDataFile::headerSize());
+        QVERIFY(header.hints.sortedByX);
+        QVERIFY(sameBounds(header.hints.bounds, ChartBounds(0, 9, -9, 0)));
+        return;
+    }
+
+    //тот же поврежденный заголовок в файле
+    if (size < 0)
+        return;
+
+    QFile out(path);
+    QVERIFY(out.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    QCOMPARE(out.write(bytes), (qint64)bytes.size());
+    out.close();
+
+    QString error;
+    QVERIFY(ChartDataFile::open(path, &error) == NULL);
+    QVERIFY(!error.isEmpty());
+}
+
+void TestChart::dataFileTruncated()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString path = dir.path() + QStringLiteral("/points.bin");
+
+    QVector<QPointF> points;
+
+    for (int i = 0; i < 100; ++i)
+        points.append(QPointF(i, i));
+
+    QVERIFY(ChartDataFile::save(path, points, ChartDataFile::Columnar));
+
+    QFile file(path);
+    const qint64 full = file.size();
+
+    //без последнего байта данных, на середине заголовка и пустой
+    const qint64 sizes[] = { full - 1, ChartDataFile::headerSize() / 2, 0 };
+
+    for (int i = 0; i < 3; ++i)
+    {
+        QVERIFY(file.resize(sizes[i]));
+
+        QString error;
+        QVERIFY(ChartDataFile::open(path, &error) == NULL);
+        QVERIFY(!error.isEmpty());
+    }
+
+    QString error;
+    QVERIFY(ChartDataFile::open(dir.path() + QStringLiteral("/missing.bin"), &error) == NULL);
+    QVERIFY(!error.isEmpty());
+}
+
+void TestChart::tiledDensity_data()
+{
+    QTest::addColumn<ChartPointData::PaintMode>("mode");
+
+    QTest::newRow("density") << ChartPointData::DensityMode;
+    QTest::newRow("auto") << ChartPointData::AutoMode;
+}
+
+void TestChart::tiledDensity()
+{
+    QFETCH(ChartPointData::PaintMode, mode);
+
+    //плотное скопление в левой полосе и редкие точки по всему виду: по отдельности
+    //правые полосы ниже порога плотности и со своим максимумом счетчика
+    std::mt19937 random(7);
+    std::normal_distribution<double> cluster(0, 20);
+    std::uniform_real_distribution<double> sparse_x(0, 1000), sparse_y(0, 500);
+
+    QVector<QPointF> points;
+
+    for (int i = 0; i < 190000; ++i)
+        points.append(QPointF(120 + cluster(random), 250 + cluster(random)));
+
+    for (int i = 0; i < 10000; ++i)
+        points.append(QPointF(sparse_x(random), sparse_y(random)));
+
+    ChartPointData item;
+    item.setPaintMode(mode);
+    item.setData(points);
+
+    const QSize size(1024, 512);
+    const ChartProjection proj = frameProjection(QRectF(0, 0, 1000, 500), size);
+
+    //деление кадра на полосы требует нескольких потоков
+    QThreadPool* pool = QThreadPool::globalInstance();
+    const int threads = pool->maxThreadCount();
+    pool->setMaxThreadCount(4);
+
+    const QVector<ChartDataItem*> items = QVector<ChartDataItem*>() << &item;
+    const QImage whole = renderFrame(items, proj, size, false);
+    const QImage tiled = renderFrame(items, proj, size, true);
+
+    pool->setMaxThreadCount(threads);
+
+    QVERIFY(!whole.isNull());
+    QVERIFY(!tiled.isNull());
+
+    //центр скопления выведен плотностью
+    QVERIFY(qAlpha(whole.pixel(123, 256)) > 0);
+    QCOMPARE(tiled, whole);
+}
+
+void TestChart::tiledStrokes_data()
+{
+    QTest::addColumn<int>("type");
+
+    QTest::newRow("dashed polygon") << int(polygs);
+    QTest::newRow("dashed decimated trajectory") << int(trajects);
+}
+
+void TestChart::tiledStrokes()
+{
+    QFETCH(int, type);
+
+    std::mt19937 random(11);
+    std::uniform_real_distribution<double> noise(-20, 20);
+
+    QScopedPointer<ChartDataItem> item;
+    QVector<QPointF> points;
+
+    if (type == polygs)
+    {
+        //контур пересекает все полосы и выходит за край вида - отсекается
+        for (int i = 0; i < 720; ++i)
+        {
+            const qreal angle = i * std::acos(-1.0) / 360;
+            points.append(QPointF(500 + 560 * std::cos(angle), 250 + 200 * std::sin(angle)));
+        }
+
+        item.reset(new ChartPolygonData());
+    }
+    else
+    {
+        //упорядоченная траектория, точек много больше столбцов - прореживается
+        for (int i = 0; i < 20000; ++i)
+            points.append(QPointF(i * 0.05, 250 + 150 * std::sin(i * 0.002) + noise(random)));
+
+        item.reset(new ChartTrajectoryData());
+        item->setPen(QPen(Qt::black, 1, Qt::DashDotLine));
+    }
+
+    item->setData(points);
+
+    const QSize size(1024, 512);
+    const ChartProjection proj = frameProjection(QRectF(0, 0, 1000, 500), size);
+
+    QThreadPool* pool = QThreadPool::globalInstance();
+    const int threads = pool->maxThreadCount();
+    pool->setMaxThreadCount(4);
+
+    const QVector<ChartDataItem*> items = QVector<ChartDataItem*>() << item.data();
+    const QImage whole = renderFrame(items, proj, size, false);
+    const QImage tiled = renderFrame(items, proj, size, true);
+
+    pool->setMaxThreadCount(threads);
+
+    QVERIFY(!whole.isNull());
+    QVERIFY(!tiled.isNull());
+
+    //штриховка продолжается через границы полос так же, как в целом кадре
+    QCOMPARE(tiled, whole);
+}
+
+void TestChart::decimateColumns_data()
+{
+    QTest::addColumn<int>("count");
+    QTest::addColumn<bool>("columnar");
+
+    //размеры вокруг блока номеров столбцов в 1024 точки
+    const int counts[] = { 1, 2, 1023, 1025, 50000 };
+
+    for (int c = 0; c < 5; ++c)
+        for (int l = 0; l < 2; ++l)
+        {
+            const QByteArray tag = QByteArray::number(counts[c]) + (l == 0 ? " pairs" : " columns");
+
+            QTest::newRow(tag.constData()) << counts[c] << (l == 1);
+        }
+}
+
+void TestChart::decimateColumns()
+{
+    QFETCH(int, count);
+    QFETCH(bool, columnar);
+
+    const qreal origin = -3.0, unit = 0.5;
+
+    std::mt19937 random(count);
+    std::uniform_real_distribution<double> inside(0.05, 0.95);
+    std::uniform_real_distribution<double> height(-100, 100);
+    std::uniform_int_distribution<int> step(0, 3);
+
+    //x внутри столбцов, вдали от их границ; в столбце от одной точки до десятков,
+    //часть столбцов пропущена
+    QVector<QPointF> points;
+    int column = 0;
+
+    while (points.size() < count)
+    {
+        const int in_column = (column % 5 == 0) ? 1 : 1 + step(random) * 10;
+        QVector<qreal> xs;
+
+        for (int k = 0; k < in_column && points.size() + xs.size() < count; ++k)
+            xs.append(origin + (column + inside(random)) * unit);
+
+        std::sort(xs.begin(), xs.end());
+
+        for (int k = 0; k < xs.size(); ++k)
+            points.append(QPointF(xs.at(k), height(random)));
+
+        column += 1 + step(random) / 3;
+    }
+
+    ChartSeries series;
+    if (columnar)
+        series.setLayout(ChartSeries::Columnar);
+    series.setData(points);
+
+    const int ranges[][2] = { { 0, count }, { count / 5, count - count / 7 } };
+
+    for (int r = 0; r < 2; ++r)
+    {
+        const int from = ranges[r][0], to = ranges[r][1];
+
+        QPolygonF result;
+        decimateByColumns(result, series, from, to, origin, unit);
+
+        const QVector<QPointF> expected = referenceColumns(points, from, to, origin, unit);
+
+        QCOMPARE(result.size(), expected.size());
+
+        for (int i = 0; i < expected.size(); ++i)
+            QCOMPARE(result.at(i), expected.at(i));
+    }
+}
+
+void TestChart::dataRange()
+{
+    std::mt19937 random(4);
+    std::uniform_real_distribution<double> value(-1e3, 1e3);
+    std::uniform_int_distribution<int> operation(0, 6);
+    std::uniform_int_distribution<int> size(1, 40);
+
+    ChartData data;
+    const DataType types[] = { points, trajects, routes };
+    ChartDataItem* items[3];
+    //точки, которые должны быть в элементах
+    std::deque<QPointF> models[3];
+    int capacities[3] = { 0, 0, 0 };
+    //буферы внешних данных живут до конца теста
+    std::deque<QVector<qreal> > buffers;
+
+    for (int t = 0; t < 3; ++t)
+        items[t] = data.createItem(types[t]);
+
+    for (int step = 0; step < 2000; ++step)
+    {
+        const int t = step % 3;
+        ChartDataItem* item = items[t];
+        std::deque<QPointF>& model = models[t];
+
+        //маршрут из одной точки не задается
+        QVector<QPointF> points(size(random) + 1);
+
+        //маршрут упорядочен по x
+        for (int i = 0; i < points.size(); ++i)
+            points[i] = QPointF(types[t] == routes ? step + i * 0.01 : value(random), value(random));
+
+        switch (operation(random))
+        {
+        case 0:
+            item->setData(points);
+            model.assign(points.begin(), points.end());
+            break;
+        case 1:
+            item->appendData(points);
+            model.insert(model.end(), points.begin(), points.end());
+            break;
+        case 2:
+            item->appendPoint(points.at(0));
+            model.push_back(points.at(0));
+            break;
+        case 3:
+            item->clearData();
+            model.clear();
+            break;
+        case 4:
+        {
+            buffers.push_back(QVector<qreal>());
+            QVector<qreal>& buffer = buffers.back();
+
+            for (int i = 0; i < points.size(); ++i)
+                buffer << points.at(i).x() << points.at(i).y();
+
+            item->setExternalData(buffer.constData(), buffer.constData() + 1, points.size(), 2);
+            model.assign(points.begin(), points.end());
+            break;
+        }
+        case 5:
+            capacities[t] = (capacities[t] == 0) ? size(random) : 0;
+            item->setCapacity(capacities[t]);
+            break;
+        default:
+            //чтение без изменений не должно сбивать кэш
+            break;
+        }
+
+        if (capacities[t] > 0 && int(model.size()) > capacities[t])
+            model.erase(model.begin(), model.end() - capacities[t]);
+
+        //прежний путь: габариты пересчитываются заново по всем точкам
+        ChartBounds expected = ChartBounds::empty();
+
+        for (int k = 0; k < 3; ++k)
+        {
+            QVector<QPointF> all;
+
+            for (size_t i = 0; i < models[k].size(); ++i)
+                all.append(models[k][i]);
+
+            expected.unite(all.isEmpty() ? ChartBounds() : naiveBounds(all));
+        }
+
+        if (qRound(expected.minX) == qRound(expected.maxX))
+        {
+            expected.minX -= 2.5;
+            expected.maxX += 2.5;
+        }
+
+        if (qRound(expected.minY) == qRound(expected.maxY))
+        {
+            expected.minY -= 2.5;
+            expected.maxY += 2.5;
+        }
+
+        QVERIFY(sameBounds(data.range(), expected));
+    }
+}
+
+void TestChart::seriesOwnership()
+{
+    static const int count = 10000;
+
+    std::mt19937 random(6);
+    std::uniform_real_distribution<double> value(-1e3, 1e3);
+
+    QVector<QPointF> points(count);
+
+    for (int i = 0; i < count; ++i)
+        points[i] = QPointF(value(random), value(random));
+
+    //перемещенный вектор становится буфером серии без копирования
+    QVector<QPointF> moved = points;
+    const qreal* raw = reinterpret_cast<const qreal*>(moved.constData());
+
+    ChartSeries series;
+    series.setData(std::move(moved));
+
+    QCOMPARE(series.xData(), raw);
+    QCOMPARE(series.yData(), raw + 1);
+    QCOMPARE(series.size(), count);
+
+    //внешний буфер удерживается серией до ее очистки
+    std::shared_ptr<QVector<qreal> > buffer = std::make_shared<QVector<qreal> >();
+
+    for (int i = 0; i < count; ++i)
+        *buffer << points.at(i).x() << points.at(i).y();
+
+    const qreal* external = buffer->constData();
+    const std::weak_ptr<QVector<qreal> > alive = buffer;
+
+    series.setExternal(external, external + 1, count, 2, buffer);
+    buffer.reset();
+
+    QVERIFY(!alive.expired());
+    QVERIFY(series.isExternal());
+    QCOMPARE(series.xData(), external);
+
+    for (int i = 0; i < count; ++i)
+        QCOMPARE(series.at(i), points.at(i));
+
+    series.clear();
+    QVERIFY(alive.expired());
+
+    //элемент с внешними данными ведет себя так же, как с копией точек
+    buffer = std::make_shared<QVector<qreal> >();
+
+    for (int i = 0; i < count; ++i)
+        *buffer << points.at(i).x() << points.at(i).y();
+
+    ChartPointData copied, shared;
+    copied.setData(points);
+    shared.setExternalData(buffer->constData(), buffer->constData() + 1, count, 2, buffer);
+
+    QVERIFY(sameBounds(shared.range(), copied.range()));
+
+    const QRectF rects[] = { QRectF(-1e3, -1e3, 2e3, 2e3), QRectF(-200, 100, 350, 400), QRectF(5e3, 0, 1, 1) };
+
+    for (int r = 0; r < 3; ++r)
+    {
+        QCOMPARE(shared.countInRect(rects[r]), copied.countInRect(rects[r]));
+        QCOMPARE(shared.pointsInRect(rects[r]), copied.pointsInRect(rects[r]));
+    }
+}
+
+void TestChart::layerCache()
+{
+    CountingItem item;
+    ChartLayer cached, plain;
+    cached.setCached(true);
+    cached.addLayer(&item);
+    plain.addLayer(&item);
+
+    const QSize size(200, 100);
+
+    //кэш рисует элементы один раз и выводит то же, что и слой без кэша
+    const QImage first = paintLayer(cached, size);
+    const QImage second = paintLayer(cached, size);
+
+    QCOMPARE(item.paints, 1);
+    QVERIFY(cached.isValid());
+    QCOMPARE(second, first);
+    QCOMPARE(first, paintLayer(plain, size));
+
+    //без invalidate() изменения элемента не видны
+    item.color = Qt::blue;
+    item.paints = 0;
+
+    QCOMPARE(paintLayer(cached, size), first);
+    QCOMPARE(item.paints, 0);
+
+    cached.invalidate();
+    QVERIFY(!cached.isValid());
+
+    const QImage changed = paintLayer(cached, size);
+
+    QCOMPARE(item.paints, 1);
+    QVERIFY(changed != first);
+    QCOMPARE(changed, paintLayer(plain, size));
+
+    //новый размер устройства перерисовывает кэш
+    item.paints = 0;
+    QCOMPARE(paintLayer(cached, QSize(120, 80)), paintLayer(plain, QSize(120, 80)));
+    QCOMPARE(item.paints, 2);
+
+    //без кэша слой рисуется каждый раз
+    cached.setCached(false);
+    item.paints = 0;
+    paintLayer(cached, size);
+    paintLayer(cached, size);
+
+    QCOMPARE(item.paints, 2);
+    QVERIFY(!cached.isValid());
+}
+
+void TestChart::asyncRender()
+{
+    std::mt19937 random(10);
+    std::uniform_real_distribution<double> value(0, 1000);
+    std::uniform_real_distribution<double> height(0, 500);
+
+    QVector<QPointF> track, scattered;
+
+    for (int i = 0; i < 3000; ++i)
+        track.append(QPointF(i * 0.3, 250 + 200 * std::sin(i * 0.01)));
+
+    for (int i = 0; i < 500; ++i)
+        scattered.append(QPointF(value(random), height(random)));
+
+    ChartTrajectoryData trajectory;
+    trajectory.setData(track);
+    ChartPointData points;
+    points.setData(scattered);
+
+    const QVector<ChartDataItem*> items = QVector<ChartDataItem*>() << &trajectory << &points;
+    const QSize size(640, 320);
+    const ChartProjection proj = frameProjection(QRectF(0, 0, 1000, 500), size);
+    const ChartProjection zoomed = frameProjection(QRectF(200, 100, 300, 150), size);
+
+    //фоновый кадр совпадает с синхронной отрисовкой
+    QCOMPARE(renderFrame(items, proj, size, false), paintDirect(items, proj, size));
+
+    //новый запрос вытесняет незавершенный: показывается только последний кадр
+    ChartRenderer renderer;
+    renderer.setTiled(false);
+
+    QSignalSpy ready(&renderer, SIGNAL(frameReady()));
+    QVector<ChartDataItem*> first, second;
+
+    for (int i = 0; i < items.size(); ++i)
+    {
+        first.append(items.at(i)->clone());
+        second.append(items.at(i)->clone());
+    }
+
+    renderer.render(first, proj, size, 1.0, QPainter::RenderHints());
+    renderer.render(second, zoomed, size, 1.0, QPainter::RenderHints());
+
+    QVERIFY(ready.wait(30000));
+    QTRY_VERIFY(!renderer.isBusy());
+
+    QCOMPARE(ready.count(), 1);
+    QVERIFY(renderer.frameProjection() == zoomed);
+    QCOMPARE(renderer.frame(), paintDirect(items, zoomed, size));
+}
+
+void TestChart::markerSprites_data()
+{
+    QTest::addColumn<bool>("subset");
+    QTest::addColumn<bool>("clipped");
+
+    //без отсечения спрайты переносятся в биты изображения, с отсечением - через QPainter
+    QTest::newRow("blit") << false << false;
+    QTest::newRow("blit subset") << true << false;
+    QTest::newRow("painter") << false << true;
+    QTest::newRow("painter subset") << true << true;
+}
+
+void TestChart::markerSprites()
+{
+    QFETCH(bool, subset);
+    QFETCH(bool, clipped);
+
+    static const qreal size = 6;
+    const QSize image_size(200, 100);
+
+    //центры в серединах пикселей: спрайт 9x9 с центром в середине пикселя ложится
+    //на те же пиксели, что и прямоугольник, нарисованный в точке; часть маркеров
+    //перекрывается и выходит за край
+    std::mt19937 random(12);
+    std::uniform_int_distribution<int> column(-3, image_size.width() + 2), row(-3, image_size.height() + 2);
+
+    QVector<QPointF> points;
+
+    for (int i = 0; i < 400; ++i)
+        points.append(QPointF(column(random) + 0.5, row(random) + 0.5));
+
+    ChartSeries series;
+    series.setData(points);
+
+    QVector<int> indexes;
+
+    for (int i = 0; i < points.size(); i += subset ? 3 : 1)
+        indexes.append(i);
+
+    const QPen pen(Qt::blue, 1);
+    const QBrush brush(QColor(255, 0, 0));
+
+    //прежний путь: прямоугольник на каждую точку, начиная с first
+    static const int first = 1;
+
+    QImage expected(image_size, QImage::Format_ARGB32_Premultiplied);
+    expected.fill(Qt::transparent);
+
+    QPainter reference(&expected);
+    reference.setPen(pen);
+    reference.setBrush(brush);
+
+    for (int k = 0; k < indexes.size(); ++k)
+    {
+        const QPointF& center = points.at(indexes.at(k));
+
+        if (indexes.at(k) >= first)
+            reference.drawRect(QRectF(center.x() - size / 2, center.y() - size / 2, size, size));
+    }
+
+    reference.end();
+
+    QImage image(image_size, QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+
+    QPainter painter(&image);
+
+    if (clipped)
+        painter.setClipRect(image.rect());
+
+    ChartMarker marker;
+    marker.setSize(size);
+    marker.paint(&painter, series, subset ? &indexes : NULL, first, pen, brush);
+    painter.end();
+
+    QCOMPARE(image, expected);
+}
+
+void TestChart::routeFillCache()
+{
+    std::mt19937 random(14);
+    std::uniform_real_distribution<double> step(0.01, 0.2);
+    std::uniform_real_distribution<double> noise(-30, 30);
+
+    //упорядоченный профиль, точек много больше столбцов - контур прореживается
+    QVector<QPointF> profile;
+    qreal x = 0;
+
+    for (int i = 0; i < 20000; ++i)
+    {
+        x += step(random);
+        profile.append(QPointF(x, 200 + 100 * std::sin(x * 0.01) + noise(random)));
+    }
+
+    const QSize size(640, 320);
+    const ChartProjection proj = frameProjection(QRectF(0, 0, 2000, 500), size);
+    const ChartProjection zoomed = frameProjection(QRectF(300, 0, 400, 500), size);
+
+    ChartRouteData route;
+    route.setData(profile.mid(0, 15000));
+
+    //контур из кэша совпадает с построенным заново элементом с теми же точками
+    QVector<QPointF> model = profile.mid(0, 15000);
+
+    for (int stage = 0; stage < 5; ++stage)
+    {
+        const ChartProjection& view = (stage == 0) ? proj : zoomed;
+
+        if (stage == 2)
+        {
+            route.appendData(profile.mid(15000));
+            model = profile;
+        }
+        else if (stage == 3)
+        {
+            route.setCapacity(12000);
+            model = profile.mid(profile.size() - 12000);
+        }
+        else if (stage == 4)
+        {
+            route.appendPoint(QPointF(x + 1, 250));
+            model = model.mid(1);
+            model.append(QPointF(x + 1, 250));
+        }
+
+        //первая отрисовка заполняет кэш, вторая берет контур из него
+        paintDirect(QVector<ChartDataItem*>() << &route, view, size);
+        const QImage cached = paintDirect(QVector<ChartDataItem*>() << &route, view, size);
+
+        ChartRouteData fresh;
+        fresh.setData(model);
+
+        QCOMPARE(cached, paintDirect(QVector<ChartDataItem*>() << &fresh, view, size));
+    }
+}
+
+void TestChart::textCache()
+{
+    QFont font;
+    font.setPixelSize(12);
+    QFont bold = font;
+    bold.setBold(true);
+
+    const QString font_key = font.key(), bold_key = bold.key();
+
+    //емкость меньше числа надписей: часть из них вытесняется и готовится заново
+    ChartTextCache cache(3);
+
+    for (int pass = 0; pass < 3; ++pass)
+        for (int i = 0; i < 8; ++i)
+        {
+            const QString str = QString::number(i * 12.5);
+            const bool use_bold = (i % 2 == 1);
+            const QFont& used = use_bold ? bold : font;
+
+            const QStaticText* text = cache.text(str, used, use_bold ? bold_key : font_key);
+
+            //раскладка из кэша совпадает с подготовленной заново
+            QStaticText fresh(str);
+            fresh.setTextFormat(Qt::PlainText);
+            fresh.prepare(QTransform(), used);
+
+            QCOMPARE(text->text(), str);
+            QCOMPARE(text->size(), fresh.size());
+
+            //повторный запрос сразу после вставки возвращает ту же надпись
+            QCOMPARE(cache.text(str, used, use_bold ? bold_key : font_key), text);
+        }
+
+    //одна строка разными шрифтами - разные надписи
+    const QStaticText* plain_text = cache.text(QStringLiteral("100"), font, font_key);
+    const QStaticText* bold_text = cache.text(QStringLiteral("100"), bold, bold_key);
+
+    QVERIFY(plain_text != bold_text);
+    QVERIFY(bold_text->size().width() >= plain_text->size().width());
+}
+
+void TestChart::declutter_data()
+{
+    QTest::addColumn<int>("count");
+    QTest::addColumn<QSizeF>("cell");
+
+    //ячейки мельче подписи, по размеру строки и крупнее всей области
+    const int counts[] = { 1, 40, 2000 };
+    const QSizeF cells[] = { QSizeF(3, 2), QSizeF(64, 16), QSizeF(1000, 1000) };
+
+    for (int c = 0; c < 3; ++c)
+        for (int k = 0; k < 3; ++k)
+        {
+            const QByteArray tag = QByteArray::number(counts[c]) + " labels, cell " + QByteArray::number(cells[k].width());
+
+            QTest::newRow(tag.constData()) << counts[c] << cells[k];
+        }
+}
+
+void TestChart::declutter()
+{
+    QFETCH(int, count);
+    QFETCH(QSizeF, cell);
+
+    const QRectF area(0, 0, 400, 300);
+
+    std::mt19937 random(count);
+    std::uniform_real_distribution<double> x(-50, 430);
+    std::uniform_real_distribution<double> y(-20, 310);
+    std::uniform_int_distribution<int> width(2, 12);
+    std::uniform_int_distribution<int> level(0, 3);
+
+    //подписи высотой в строку, часть целиком или частично за пределами области;
+    //левые верхние углы на целых пикселях, поэтому касание краями возможно
+    QVector<QRectF> rects;
+    QVector<int> priority;
+
+    for (int i = 0; i < count; ++i)
+    {
+        rects.append(QRectF(std::floor(x(random)), std::floor(y(random)), width(random) * 6, 14));
+        priority.append(level(random));
+    }
+
+    QVector<int> order(count);
+    for (int i = 0; i < count; ++i)
+        order[i] = i;
+
+    std::stable_sort(order.begin(), order.end(), [&priority](int a, int b) { return priority.at(a) > priority.at(b); });
+
+    QVector<int> visible;
+    declutterRects(rects, order, area, cell, visible);
+
+    //тот же набор и порядок, что у полного перебора
+    QCOMPARE(visible, referenceDeclutter(rects, order, area));
+
+    //оставленные подписи не перекрываются и видны хотя бы частично
+    for (int i = 0; i < visible.size(); ++i)
+    {
+        QVERIFY(rects.at(visible.at(i)).intersects(area));
+
+        for (int k = i + 1; k < visible.size(); ++k)
+            QVERIFY(!rects.at(visible.at(i)).intersects(rects.at(visible.at(k))));
+    }
+
+    //каждая отброшенная подпись внутри области перекрыта оставленной не ниже приоритетом
+    QVector<bool> kept(count, false);
+    for (int i = 0; i < visible.size(); ++i)
+        kept[visible.at(i)] = true;
+
+    for (int i = 0; i < count; ++i)
+    {
+        if (kept.at(i) || !rects.at(i).intersects(area))
+            continue;
+
+        bool covered = false;
+        for (int k = 0; k < visible.size() && !covered; ++k)
+            covered = rects.at(visible.at(k)).intersects(rects.at(i)) && priority.at(visible.at(k)) >= priority.at(i);
+
+        QVERIFY(covered);
+    }
+
+    //повторное прореживание дает тот же набор
+    QVector<int> again;
+    declutterRects(rects, order, area, cell, again);
+    QCOMPARE(again, visible);
+
+    //при сдвиге области вместе с подписями набор не меняется
+    const QPointF shift(37.5, -11.25);
+    QVector<QRectF> shifted(count);
+    for (int i = 0; i < count; ++i)
+        shifted[i] = rects.at(i).translated(shift);
+
+    declutterRects(shifted, order, area.translated(shift), cell, again);
+    QCOMPARE(again, visible);
+}
+
+void TestChart::gridCache()
+{
+    const QSize size(200, 120);
+    const QPen zero_pen(Qt::gray, 0.8, Qt::DashDotDotLine);
+    const QPen dash_pen(Qt::gray, 0.8, Qt::DashDotDotLine);
+    const QPen solid_pen(Qt::red, 1.5, Qt::SolidLine);
+
+    ChartGrid cached, plain;
+    cached.setZeroLinePen(zero_pen);
+    cached.setGridPen(dash_pen);
+    plain.setZeroLinePen(zero_pen);
+    plain.setGridPen(dash_pen);
+    plain.setCached(false);
+
+    //линии не делят пикселей, поэтому пакетный вызов совпадает с отдельными
+    const QVector<QLineF> lines = verticalGrid(10.5, 20, size);
+    const QImage expected = referenceGrid(lines, zero_pen, dash_pen, size);
+
+    QCOMPARE(paintGrid(plain, lines, size), expected);
+    QCOMPARE(paintGrid(cached, lines, size), expected);
+
+    //повторный вывод из растра
+    QCOMPARE(paintGrid(cached, lines, size), expected);
+
+    //смена пера сбрасывает растр
+    cached.setGridPen(solid_pen);
+    QCOMPARE(paintGrid(cached, lines, size), referenceGrid(lines, zero_pen, solid_pen, size));
+
+    cached.setGridPen(dash_pen);
+    QCOMPARE(paintGrid(cached, lines, size), expected);
+
+    //сдвиг диапазона и новый шаг меняют линии
+    const QVector<QLineF> panned = verticalGrid(3.25, 20, size);
+    QCOMPARE(paintGrid(cached, panned, size), referenceGrid(panned, zero_pen, dash_pen, size));
+
+    const QVector<QLineF> finer = verticalGrid(5.5, 12, size);
+    QCOMPARE(paintGrid(cached, finer, size), referenceGrid(finer, zero_pen, dash_pen, size));
+
+    //новый размер виджета
+    const QSize resized(140, 90);
+    const QVector<QLineF> smaller = verticalGrid(10.5, 20, resized);
+    QCOMPARE(paintGrid(cached, smaller, resized), referenceGrid(smaller, zero_pen, dash_pen, resized));
+
+    //только нулевая линия
+    const QVector<QLineF> zero_only = verticalGrid(size.width(), 20, size);
+    QCOMPARE(zero_only.size(), 1);
+    QCOMPARE(paintGrid(cached, zero_only, size), referenceGrid(zero_only, zero_pen, dash_pen, size));
+}
+
+void TestChart::simplifyContour_data()
+{
+    QTest::addColumn<double>("tolerance");
+    QTest::addColumn<bool>("closed");
+
+    const double tolerances[] = { 0.25, 2, 15 };
+
+    for (int t = 0; t < 3; ++t)
+        for (int c = 0; c < 2; ++c)
+        {
+            const QByteArray tag = "tolerance " + QByteArray::number(tolerances[t]) + (c == 1 ? " closed" : " open");
+
+            QTest::newRow(tag.constData()) << tolerances[t] << (c == 1);
+        }
+}
+
+void TestChart::simplifyContour()
+{
+    QFETCH(double, tolerance);
+    QFETCH(bool, closed);
+
+    std::mt19937 random(7);
+    std::uniform_real_distribution<double> noise(-3, 3);
+
+    //неровная окружность; замкнутый контур повторяет первую точку в конце
+    QPolygonF contour;
+    const int count = 600;
+    const double pi = std::acos(-1.0);
+
+    for (int i = 0; i < count; ++i)
+    {
+        const double angle = 2 * pi * i / count;
+        const double radius = 100 + 10 * std::sin(angle * 7) + noise(random);
+
+        contour.append(QPointF(radius * std::cos(angle), radius * std::sin(angle)));
+    }
+
+    if (closed)
+        contour.append(contour.first());
+
+    const QPolygonF result = simplifyPolygon(contour, tolerance);
+
+    //замкнутость сохраняется
+    QCOMPARE(result.first() == result.last(), closed);
+
+    QPolygonF ring = result;
+    if (closed)
+        ring.removeLast();
+
+    QVERIFY(ring.size() >= 3);
+    QVERIFY(ring.size() < count);
+
+    //оставшиеся вершины - исходные, в исходном порядке, начиная с первой
+    QCOMPARE(ring.first(), contour.first());
+
+    for (int i = 0, k = 0; i < ring.size(); ++i, ++k)
+    {
+        while (k < count && contour.at(k) != ring.at(i))
+            ++k;
+
+        QVERIFY(k < count);
+    }
+
+    //каждая исходная вершина не дальше tolerance от упрощенного контура
+    for (int i = 0; i < count; ++i)
+        QVERIFY(ringDistance(contour.at(i), ring) <= tolerance * (1 + 1e-9));
+
+    //квадрат с вершинами на сторонах упрощается до углов
+    QPolygonF square;
+    for (int i = 0; i < 10; ++i)
+        square.append(QPointF(i * 10, 0));
+    for (int i = 0; i < 10; ++i)
+        square.append(QPointF(100, i * 10));
+    for (int i = 0; i < 10; ++i)
+        square.append(QPointF(100 - i * 10, 100));
+    for (int i = 0; i < 10; ++i)
+        square.append(QPointF(0, 100 - i * 10));
+    if (closed)
+        square.append(square.first());
+
+    QPolygonF corners;
+    corners << QPointF(0, 0) << QPointF(100, 0) << QPointF(100, 100) << QPointF(0, 100);
+    if (closed)
+        corners.append(corners.first());
+
+    QCOMPARE(simplifyPolygon(square, tolerance), corners);
+
+    //мелкие контуры и нулевой допуск не меняются
+    QCOMPARE(simplifyPolygon(corners, tolerance), corners);
+    QCOMPARE(simplifyPolygon(contour, 0), contour);
+}
+
+void TestChart::clipContour_data()
+{
+    QTest::addColumn<QPolygonF>("polygon");
+    QTest::addColumn<QRectF>("rect");
+    QTest::addColumn<QPolygonF>("expected");
+
+    const QRectF rect(0, 0, 100, 100);
+
+    QPolygonF inside;
+    inside << QPointF(10, 10) << QPointF(90, 20) << QPointF(50, 95) << QPointF(0, 100);
+    QTest::newRow("inside") << inside << rect << inside;
+
+    QPolygonF outside;
+    outside << QPointF(110, 10) << QPointF(190, 20) << QPointF(150, 95);
+    QTest::newRow("outside") << outside << rect << QPolygonF();
+
+    //охватывает угол области: ребра пересекают левую и верхнюю границы
+    QPolygonF corner;
+    corner << QPointF(-50, -50) << QPointF(50, -50) << QPointF(50, 50) << QPointF(-50, 50);
+    QPolygonF corner_clipped;
+    corner_clipped << QPointF(0, 0) << QPointF(50, 0) << QPointF(50, 50) << QPointF(0, 50);
+    QTest::newRow("straddling corner") << corner << rect << corner_clipped;
+
+    //треугольник, срезанный правой границей
+    QPolygonF triangle;
+    triangle << QPointF(20, 20) << QPointF(180, 20) << QPointF(20, 80);
+    QPolygonF triangle_clipped;
+    triangle_clipped << QPointF(20, 20) << QPointF(100, 20) << QPointF(100, 50) << QPointF(20, 80);
+    QTest::newRow("straddling edge") << triangle << rect << triangle_clipped;
+
+    //контур целиком охватывает область
+    QPolygonF enclosing;
+    enclosing << QPointF(-10, -10) << QPointF(200, -10) << QPointF(200, 200) << QPointF(-10, 200);
+    QPolygonF enclosing_clipped;
+    enclosing_clipped << QPointF(0, 100) << QPointF(0, 0) << QPointF(100, 0) << QPointF(100, 100);
+    QTest::newRow("enclosing") << enclosing << rect << enclosing_clipped;
+}
+
+void TestChart::clipContour()
+{
+    QFETCH(QPolygonF, polygon);
+    QFETCH(QRectF, rect);
+    QFETCH(QPolygonF, expected);
+
+    QPolygonF result, buffer;
+    clipPolygon(polygon, rect, result, buffer);
+
+    QCOMPARE(result, expected);
+
+    //рабочие массивы от предыдущего вызова не влияют на результат
+    QPolygonF again, dirty;
+    again << QPointF(1, 2) << QPointF(3, 4);
+    dirty = again;
+
+    clipPolygon(polygon, rect, again, dirty);
+    QCOMPARE(again, expected);
+}
+
+void TestChart::pyramid_data()
+{
+    QTest::addColumn<int>("count");
+
+    //меньше блока, на границах блоков нижнего и следующего уровней и несколько уровней
+    QTest::newRow("1") << 1;
+    QTest::newRow("16") << 16;
+    QTest::newRow("65") << 65;
+    QTest::newRow("5000") << 5000;
+    QTest::newRow("70000") << 70000;
+}
+
+void TestChart::pyramid()
+{
+    QFETCH(int, count);
+
+    std::mt19937 random(count);
+    std::uniform_int_distribution<int> height(-20, 20);
+    std::uniform_int_distribution<int> chunk(0, 3);
+
+    //целые y с повторами: минимум и максимум блока неоднозначны
+    QVector<QPointF> points;
+    for (int i = 0; i < count; ++i)
+        points.append(QPointF(i, height(random)));
+
+    //дозапись порциями разного размера с досчетом после каждой
+    const int chunks[] = { 1, 15, 17, 1000 };
+
+    ChartSeries series;
+    ChartPyramid incremental;
+
+    for (int appended = 0; appended < count; )
+    {
+        const int size = qMin(chunks[chunk(random)], count - appended);
+
+        series.append(points.constData() + appended, size);
+        appended += size;
+
+        incremental.update(series);
+        QCOMPARE(incremental.count(), appended);
+
+        if (appended == count || appended % 7 == 0)
+            QVERIFY(samePyramid(incremental, series, points.mid(0, appended)));
+    }
+
+    //досчитанная пирамида совпадает с построенной сразу
+    ChartPyramid full;
+    full.update(series);
+
+    QCOMPARE(incremental.levelCount(), full.levelCount());
+    QVERIFY(samePyramid(full, series, points));
+    QVERIFY(samePyramid(incremental, series, points));
+
+    //верхний уровень - единственный блок
+    QVERIFY(full.levelCount() >= 1);
+    QVERIFY(full.bucketSize(full.levelCount() - 1) >= count);
+    QVERIFY(full.levelCount() == 1 || full.bucketSize(full.levelCount() - 2) < count);
+
+    //уровень по размеру блока: самый грубый, не крупнее max_bucket
+    const qreal buckets[] = { 0, 15.9, 16, 63.9, 64, 300, 1e4, 1e9 };
+
+    for (int i = 0; i < 8; ++i)
+    {
+        int expected = -1;
+
+        for (int level = 0; level < full.levelCount(); ++level)
+            if (full.bucketSize(level) <= buckets[i])
+                expected = level;
+
+        QCOMPARE(full.levelFor(buckets[i]), expected);
+    }
+
+    //укороченная серия пересчитывается заново
+    const QVector<QPointF> shorter = points.mid(0, count / 2 + 1);
+    series.setData(shorter);
+    incremental.update(series);
+
+    QCOMPARE(incremental.count(), shorter.size());
+    QVERIFY(samePyramid(incremental, series, shorter));
+}
+
+QTEST_MAIN(TestChart)
+
+#include "tst_chart.moc"
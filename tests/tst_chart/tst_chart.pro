@@ -0,0 +1,11 @@
+QT += testlib widgets
+
+CONFIG += c++11 testcase console
+CONFIG -= app_bundle
+
+TARGET = tst_chart
+
+include(../../chart/chart.pro)
+
+SOURCES += \
+    tst_chart.cpp